@@ -0,0 +1,86 @@
+# Writes a translation unit with one interface of METHODS virtual functions taking and returning
+# std::unique_ptr, and its mock built with either the legacy MOCK_UNIQUE_METHODn macros (STYLE=legacy)
+# or MOCK_UNIQUE_METHOD (STYLE=variadic). Methods take from 0 to ARITY arguments, at most 10 for legacy
+# macros. Used by the mock_compile_time target.
+#
+#   cmake -DSTYLE=variadic -DMETHODS=300 -DARITY=6 -DOUTPUT=large_mock.cpp -P generate_large_mock.cmake
+
+cmake_policy(SET CMP0054 NEW)
+
+if(NOT STYLE MATCHES "^(legacy|variadic)$")
+  message(FATAL_ERROR "STYLE must be legacy or variadic")
+endif()
+
+if(NOT ARITY)
+  set(ARITY 6)
+endif()
+if(STYLE STREQUAL "legacy" AND ARITY GREATER 10)
+  set(ARITY 10)
+endif()
+
+set(arg_types "std::unique_ptr<item>" "int" "const std::string&" "std::unique_ptr<item>" "double" "item&")
+set(interface "")
+set(mock "")
+
+math(EXPR last "${METHODS} - 1")
+foreach(i RANGE ${last})
+  math(EXPR arity "${i} % (${ARITY} + 1)")
+  math(EXPR is_const "${i} % 2")
+  math(EXPR returns_unique "${i} % 3")
+
+  if(returns_unique EQUAL 0)
+    set(result "int")
+  else()
+    set(result "std::unique_ptr<item>")
+  endif()
+
+  set(args "")
+  if(arity GREATER 0)
+    math(EXPR last_arg "${arity} - 1")
+    foreach(a RANGE ${last_arg})
+      math(EXPR t "(${a} + ${i}) % 6")
+      list(GET arg_types ${t} type)
+      if(a GREATER 0)
+        set(args "${args}, ")
+      endif()
+      set(args "${args}${type}")
+    endforeach()
+  endif()
+
+  if(is_const)
+    set(qualifier " const")
+    set(legacy_macro "MOCK_UNIQUE_CONST_METHOD${arity}")
+    set(specs "(const, override)")
+  else()
+    set(qualifier "")
+    set(legacy_macro "MOCK_UNIQUE_METHOD${arity}")
+    set(specs "(override)")
+  endif()
+
+  set(interface "${interface}  virtual ${result} m${i}(${args})${qualifier} = 0;\n")
+  if(STYLE STREQUAL "legacy")
+    set(mock "${mock}  ${legacy_macro}(m${i}, ${result}(${args}));\n")
+  else()
+    set(mock "${mock}  MOCK_UNIQUE_METHOD(${result}, m${i}, (${args}), ${specs});\n")
+  endif()
+endforeach()
+
+file(WRITE "${OUTPUT}"
+"// Generated by bench/generate_large_mock.cmake, STYLE=${STYLE} METHODS=${METHODS} ARITY=${ARITY}
+#include <memory>
+#include <string>
+#include \"gmock_macros_for_unique_ptr.hpp\"
+
+struct item { virtual ~item() = default; };
+
+struct large_interface
+{
+${interface}  virtual ~large_interface() = default;
+};
+
+struct large_mock : large_interface
+{
+${mock}};
+
+void instantiate_large_mock() { testing::NiceMock<large_mock> m; }
+")
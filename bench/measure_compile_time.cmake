@@ -0,0 +1,36 @@
+# Compiles SOURCE with -fsyntax-only -ftime-report and appends front-end time and memory reported by
+# compiler to RESULTS, so template cost of gmock macros can be compared between builds.
+#
+#   cmake -DCOMPILER=g++ -DINCLUDE_DIRS="inc|gmock/include|gtest/include" -DSOURCE=large_mock.cpp
+#         -DLABEL=variadic -DRESULTS=mock_compile_time.csv -P measure_compile_time.cmake
+
+cmake_policy(SET CMP0054 NEW)
+
+string(REPLACE "|" ";" include_dirs "${INCLUDE_DIRS}")
+set(flags -std=c++11 -fsyntax-only -ftime-report)
+foreach(dir ${include_dirs})
+  list(APPEND flags -isystem ${dir})
+endforeach()
+
+execute_process(COMMAND ${COMPILER} ${flags} ${SOURCE}
+                RESULT_VARIABLE result OUTPUT_QUIET ERROR_VARIABLE report)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${SOURCE} does not compile:\n${report}")
+endif()
+
+set(seconds "n/a")
+set(memory "n/a")
+# g++: " TOTAL : usr sys wall memory"
+if(report MATCHES "TOTAL *: *[0-9.]+ *[0-9.]+ *([0-9.]+) *([0-9]+[kMG]?)")
+  set(seconds "${CMAKE_MATCH_1}")
+  set(memory "${CMAKE_MATCH_2}")
+# clang++: "Total Execution Time: cpu seconds (wall wall clock)"
+elseif(report MATCHES "Total Execution Time: [0-9.]+ seconds \\(([0-9.]+) wall clock\\)")
+  set(seconds "${CMAKE_MATCH_1}")
+endif()
+
+if(NOT EXISTS "${RESULTS}")
+  file(WRITE "${RESULTS}" "label,source,seconds,memory\n")
+endif()
+file(APPEND "${RESULTS}" "${LABEL},${SOURCE},${seconds},${memory}\n")
+message(STATUS "${LABEL}: ${seconds} s, ${memory} memory")
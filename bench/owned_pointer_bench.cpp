@@ -0,0 +1,489 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "owned_pointer.hpp"
+#include "allocation_counter.hpp"
+
+namespace
+{
+
+struct polymorphic
+{
+  virtual ~polymorphic() = default;
+  int value = 1;
+};
+
+struct derived : polymorphic
+{
+};
+
+struct plain
+{
+  int value = 1;
+};
+
+template<typename T, typename Policy = csp::thread_safe>
+using pointer = csp::owned_pointer<T, Policy>;
+
+auto allocations_per_iteration(const std::size_t count) -> benchmark::Counter
+{
+  return benchmark::Counter(static_cast<double>(count), benchmark::Counter::kAvgIterations);
+}
+
+/*
+ * Counts allocations made while scope exists and reports them per iteration.
+ */
+class allocation_scope
+{
+public:
+  explicit allocation_scope(benchmark::State& s) noexcept
+    : state(s), start(allocation_count())
+  {}
+
+  ~allocation_scope()
+  {
+    state.counters["allocs_per_op"] = allocations_per_iteration(allocation_count() - start);
+  }
+
+private:
+  benchmark::State& state;
+  const std::size_t start;
+};
+
+/*****************************************************************************************
+ *
+ * Creation
+ *
+ *****************************************************************************************/
+
+template<typename T>
+void make_owned(benchmark::State& state)
+{
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    auto p = csp::make_owned<T>();
+    benchmark::DoNotOptimize(p);
+  }
+}
+
+template<typename T>
+void make_shared(benchmark::State& state)
+{
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    auto p = std::make_shared<T>();
+    benchmark::DoNotOptimize(p);
+  }
+}
+
+template<typename T>
+void make_unique(benchmark::State& state)
+{
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    auto p = std::unique_ptr<T>{new T{}};
+    benchmark::DoNotOptimize(p);
+  }
+}
+
+template<typename T>
+void make_owned_and_acquire(benchmark::State& state)
+{
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    auto u = csp::make_owned<T>().unique_ptr();
+    benchmark::DoNotOptimize(u);
+  }
+}
+
+/*
+ * Object goes from std::unique_ptr through owned_pointer and back, as it does
+ * through mocked method taking std::unique_ptr argument.
+ */
+template<typename T>
+void pass_through(benchmark::State& state)
+{
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    const pointer<T> p{std::unique_ptr<T>{new T{}}};
+    auto u = p.unique_ptr();
+    benchmark::DoNotOptimize(u);
+  }
+}
+
+/*
+ * The same, but argument is also copied, as gmock action saving it does, so
+ * control block is created and comes from pool of freed ones.
+ */
+template<typename T>
+void pass_through_copied(benchmark::State& state)
+{
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    const pointer<T> p{std::unique_ptr<T>{new T{}}};
+    const auto saved = p;
+    auto u = saved.unique_ptr();
+    benchmark::DoNotOptimize(u);
+  }
+}
+
+/*****************************************************************************************
+ *
+ * Handle operations
+ *
+ *****************************************************************************************/
+
+template<typename T, typename Policy>
+void copy(benchmark::State& state)
+{
+  const pointer<T, Policy> p = csp::make_owned<T>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    auto copy = p;
+    benchmark::DoNotOptimize(copy);
+  }
+}
+
+template<typename T, typename Policy>
+void copy_observer(benchmark::State& state)
+{
+  const pointer<T, Policy> p = csp::make_owned<T>();
+  const csp::owned_observer<T, Policy> observer = p;
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    auto copy = observer;
+    benchmark::DoNotOptimize(copy);
+  }
+}
+
+template<typename T>
+void observer_expired(benchmark::State& state)
+{
+  const pointer<T> p = csp::make_owned<T>();
+  const csp::owned_observer<T> observer = p;
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+    benchmark::DoNotOptimize(observer.expired());
+}
+
+template<typename T, typename Policy>
+void move(benchmark::State& state)
+{
+  pointer<T, Policy> p = csp::make_owned<T>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    auto moved = std::move(p);
+    benchmark::DoNotOptimize(moved);
+    p = std::move(moved);
+  }
+}
+
+template<typename T, typename Policy>
+void get(benchmark::State& state)
+{
+  const pointer<T, Policy> p = csp::make_owned<T>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+    benchmark::DoNotOptimize(p.get());
+}
+
+template<typename T>
+void get_nothrow(benchmark::State& state)
+{
+  const pointer<T> p = csp::make_owned<T>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+    benchmark::DoNotOptimize(p.get(std::nothrow));
+}
+
+template<typename T, typename Policy>
+void arrow(benchmark::State& state)
+{
+  const pointer<T, Policy> p = csp::make_owned<T>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+    benchmark::DoNotOptimize(p->value);
+}
+
+template<typename T>
+void raw_pointer_arrow(benchmark::State& state)
+{
+  const std::unique_ptr<T> u{new T{}};
+  T* p = u.get();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    benchmark::DoNotOptimize(p);
+    benchmark::DoNotOptimize(p->value);
+  }
+}
+
+template<typename T>
+void expired(benchmark::State& state)
+{
+  const pointer<T> p = csp::make_owned<T>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+    benchmark::DoNotOptimize(p.expired());
+}
+
+template<typename T>
+auto acquire(const pointer<T>& p, std::unique_ptr<T>*) -> std::unique_ptr<T>
+{
+  return p.unique_ptr();
+}
+
+template<typename T>
+auto acquire(const pointer<T>& p, csp::tracked_unique_ptr<T>*) -> csp::tracked_unique_ptr<T>
+{
+  return p.tracked_unique_ptr();
+}
+
+/*
+ * Object can be acquired only once, so batch of fresh pointers is created
+ * and acquired objects are deleted outside of measured time.
+ */
+template<typename T, typename Unique = std::unique_ptr<T>>
+void unique_ptr(benchmark::State& state)
+{
+  constexpr std::size_t batch = 1024;
+
+  std::vector<pointer<T>> pointers;
+  std::vector<Unique> objects;
+  pointers.reserve(batch);
+  objects.reserve(batch);
+
+  std::size_t count = 0;
+
+  for(auto _ : state)
+  {
+    if(pointers.empty())
+    {
+      state.PauseTiming();
+      objects.clear();
+      for(std::size_t i = 0; i < batch; i++)
+        pointers.push_back(csp::make_owned<T>());
+      state.ResumeTiming();
+    }
+
+    const auto start = allocation_count();
+    objects.push_back(acquire(pointers.back(), static_cast<Unique*>(nullptr)));
+    count += allocation_count() - start;
+
+    pointers.pop_back();
+  }
+
+  state.counters["allocs_per_op"] = allocations_per_iteration(count);
+}
+
+template<typename Policy>
+void static_pointer_cast(benchmark::State& state)
+{
+  const pointer<derived, Policy> p = csp::make_owned<derived>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    auto base = csp::static_pointer_cast<polymorphic>(p);
+    benchmark::DoNotOptimize(base);
+  }
+}
+
+#if OWNED_POINTER_RTTI
+template<typename Policy>
+void dynamic_pointer_cast(benchmark::State& state)
+{
+  const pointer<polymorphic, Policy> p = csp::make_owned<derived>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    auto d = csp::dynamic_pointer_cast<derived>(p);
+    benchmark::DoNotOptimize(d);
+  }
+}
+#endif
+
+template<typename T>
+void compare_equal(benchmark::State& state)
+{
+  const pointer<T> p = csp::make_owned<T>(), r = csp::make_owned<T>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+    benchmark::DoNotOptimize(p == r);
+}
+
+template<typename T>
+void compare_less(benchmark::State& state)
+{
+  const pointer<T> p = csp::make_owned<T>(), r = csp::make_owned<T>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+    benchmark::DoNotOptimize(p < r);
+}
+
+template<typename T>
+void compare_nullptr(benchmark::State& state)
+{
+  const pointer<T> p = csp::make_owned<T>();
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+    benchmark::DoNotOptimize(p != nullptr);
+}
+
+/*****************************************************************************************
+ *
+ * Threading policies
+ *
+ *****************************************************************************************/
+
+template<typename Policy>
+long take_by_value(pointer<polymorphic, Policy> p)
+{
+  return p.use_count();
+}
+
+template<typename Policy>
+void fan_out(benchmark::State& state)
+{
+  const pointer<polymorphic, Policy> p = csp::make_owned<polymorphic>();
+  std::vector<pointer<polymorphic, Policy>> copies;
+  copies.reserve(9);
+
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+  {
+    copies.assign(9, p);
+    benchmark::DoNotOptimize(copies.data());
+    copies.clear();
+  }
+}
+
+template<typename Policy>
+void pass_by_value(benchmark::State& state)
+{
+  const pointer<polymorphic, Policy> p = csp::make_owned<polymorphic>();
+  long (*volatile function)(pointer<polymorphic, Policy>) = &take_by_value<Policy>;
+
+  allocation_scope scope{state};
+
+  for(auto _ : state)
+    benchmark::DoNotOptimize(function(p));
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(make_owned, polymorphic);
+BENCHMARK_TEMPLATE(make_owned, plain);
+BENCHMARK_TEMPLATE(make_shared, polymorphic);
+BENCHMARK_TEMPLATE(make_shared, plain);
+BENCHMARK_TEMPLATE(make_unique, polymorphic);
+BENCHMARK_TEMPLATE(make_unique, plain);
+BENCHMARK_TEMPLATE(make_owned_and_acquire, polymorphic);
+BENCHMARK_TEMPLATE(make_owned_and_acquire, plain);
+BENCHMARK_TEMPLATE(pass_through, polymorphic);
+BENCHMARK_TEMPLATE(pass_through, plain);
+BENCHMARK_TEMPLATE(pass_through_copied, polymorphic);
+BENCHMARK_TEMPLATE(pass_through_copied, plain);
+
+BENCHMARK_TEMPLATE(copy, polymorphic, csp::thread_safe);
+BENCHMARK_TEMPLATE(copy, polymorphic, csp::single_threaded);
+BENCHMARK_TEMPLATE(copy, plain, csp::thread_safe);
+BENCHMARK_TEMPLATE(copy, plain, csp::single_threaded);
+BENCHMARK_TEMPLATE(copy_observer, polymorphic, csp::thread_safe);
+BENCHMARK_TEMPLATE(copy_observer, polymorphic, csp::single_threaded);
+BENCHMARK_TEMPLATE(move, polymorphic, csp::thread_safe);
+BENCHMARK_TEMPLATE(move, plain, csp::thread_safe);
+
+BENCHMARK_TEMPLATE(get, polymorphic, csp::thread_safe);
+BENCHMARK_TEMPLATE(get, polymorphic, csp::unchecked<>);
+BENCHMARK_TEMPLATE(get, plain, csp::thread_safe);
+BENCHMARK_TEMPLATE(get_nothrow, polymorphic);
+BENCHMARK_TEMPLATE(get_nothrow, plain);
+BENCHMARK_TEMPLATE(arrow, polymorphic, csp::thread_safe);
+BENCHMARK_TEMPLATE(arrow, polymorphic, csp::debug_checked<>);
+BENCHMARK_TEMPLATE(arrow, polymorphic, csp::unchecked<>);
+BENCHMARK_TEMPLATE(arrow, plain, csp::thread_safe);
+BENCHMARK_TEMPLATE(raw_pointer_arrow, polymorphic);
+BENCHMARK_TEMPLATE(raw_pointer_arrow, plain);
+BENCHMARK_TEMPLATE(expired, polymorphic);
+BENCHMARK_TEMPLATE(expired, plain);
+BENCHMARK_TEMPLATE(observer_expired, polymorphic);
+BENCHMARK_TEMPLATE(unique_ptr, polymorphic);
+BENCHMARK_TEMPLATE(unique_ptr, plain);
+BENCHMARK_TEMPLATE(unique_ptr, polymorphic, csp::tracked_unique_ptr<polymorphic>);
+BENCHMARK_TEMPLATE(unique_ptr, plain, csp::tracked_unique_ptr<plain>);
+
+BENCHMARK_TEMPLATE(static_pointer_cast, csp::thread_safe);
+BENCHMARK_TEMPLATE(static_pointer_cast, csp::single_threaded);
+#if OWNED_POINTER_RTTI
+BENCHMARK_TEMPLATE(dynamic_pointer_cast, csp::thread_safe);
+BENCHMARK_TEMPLATE(dynamic_pointer_cast, csp::single_threaded);
+#endif
+
+BENCHMARK_TEMPLATE(compare_equal, polymorphic);
+BENCHMARK_TEMPLATE(compare_equal, plain);
+BENCHMARK_TEMPLATE(compare_less, polymorphic);
+BENCHMARK_TEMPLATE(compare_less, plain);
+BENCHMARK_TEMPLATE(compare_nullptr, polymorphic);
+BENCHMARK_TEMPLATE(compare_nullptr, plain);
+
+BENCHMARK_TEMPLATE(fan_out, csp::thread_safe);
+BENCHMARK_TEMPLATE(fan_out, csp::single_threaded);
+BENCHMARK_TEMPLATE(pass_by_value, csp::thread_safe);
+BENCHMARK_TEMPLATE(pass_by_value, csp::single_threaded);
+
+BENCHMARK_MAIN();
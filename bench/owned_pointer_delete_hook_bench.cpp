@@ -0,0 +1,112 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "owned_pointer.hpp"
+
+/*
+ * Built twice, with and without OWNED_POINTER_DELETE_HOOK, so cost added to
+ * every operator delete of program can be compared.
+ */
+#ifdef OWNED_POINTER_DELETE_HOOK
+OWNED_POINTER_DEFINE_DELETE_HOOK()
+#endif
+
+namespace
+{
+
+struct plain
+{
+  int value = 1;
+};
+
+/*
+ * Objects tracked by owned_pointers while other memory is freed. With many of
+ * them registry filter gives more false positives.
+ */
+auto tracked_objects(const benchmark::State& state) -> std::vector<csp::owned_pointer<plain>>
+{
+  std::vector<csp::owned_pointer<plain>> pointers;
+  for(auto i = 0; i < state.range(0); i++)
+    pointers.push_back(csp::make_owned<plain>());
+
+  return pointers;
+}
+
+void delete_untracked(benchmark::State& state)
+{
+  const auto pointers = tracked_objects(state);
+
+  for(auto _ : state)
+  {
+    auto p = new plain{};
+    benchmark::DoNotOptimize(p);
+    delete p;
+  }
+}
+
+/*
+ * Acquired objects are deleted in batches, while their owned_pointers still
+ * exist, so creation and acquisition stay outside of measured time. Counter
+ * reports time of single delete.
+ */
+void delete_acquired(benchmark::State& state)
+{
+  constexpr auto batch = 1000;
+  const auto pointers = tracked_objects(state);
+  std::vector<csp::owned_pointer<plain>> owners;
+  std::vector<std::unique_ptr<plain>> objects;
+
+  for(auto _ : state)
+  {
+    state.PauseTiming();
+    for(auto i = 0; i < batch; i++)
+    {
+      owners.push_back(csp::make_owned<plain>());
+      objects.push_back(owners.back().unique_ptr());
+    }
+    state.ResumeTiming();
+
+    for(auto& object : objects)
+      object.reset();
+
+    state.PauseTiming();
+    objects.clear();
+    owners.clear();
+    state.ResumeTiming();
+  }
+
+  state.counters["per_delete"] = benchmark::Counter(batch, benchmark::Counter::kIsIterationInvariantRate |
+                                                           benchmark::Counter::kInvert);
+}
+
+} // namespace
+
+BENCHMARK(delete_untracked)->Arg(0)->Arg(1000)->Arg(100000);
+BENCHMARK(delete_acquired)->Arg(0)->Arg(1000)->Arg(100000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,344 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#include "owned_pointer.hpp"
+
+/*
+ * Stress test and scaling benchmark of owned_pointer shared between threads.
+ * Every scenario runs with growing number of threads and reports throughput,
+ * while semantics of ownership are checked in every round. Non zero exit code
+ * means that semantics were violated, so it can be run under ThreadSanitizer.
+ *
+ * usage: owned_pointer_stress [max_threads] [milliseconds_per_point]
+ */
+namespace
+{
+
+struct item
+{
+  virtual ~item() = default;
+};
+
+using pointer = csp::owned_pointer<item>;
+using clock_type = std::chrono::steady_clock;
+
+std::atomic<unsigned> failures{0};
+
+void expect(const bool condition, const char *const what)
+{
+  if(!condition)
+  {
+    failures.fetch_add(1, std::memory_order_relaxed);
+    std::fprintf(stderr, "violated: %s\n", what);
+  }
+}
+
+class spin_barrier
+{
+public:
+  explicit spin_barrier(const unsigned n) noexcept : threads(n) {}
+
+  void arrive_and_wait() noexcept
+  {
+    const auto current = generation.load(std::memory_order_acquire);
+
+    if(waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == threads)
+    {
+      waiting.store(0, std::memory_order_relaxed);
+      generation.fetch_add(1, std::memory_order_release);
+      return;
+    }
+
+    while(generation.load(std::memory_order_acquire) == current)
+      std::this_thread::yield();
+  }
+
+private:
+  const unsigned threads;
+  std::atomic<unsigned> waiting{0};
+  std::atomic<unsigned> generation{0};
+};
+
+/*
+ * Runs body on given number of threads until time is up and returns number
+ * of operations per second reported by all of them. Round based scenarios
+ * report finished rounds from the first thread only.
+ */
+using scenario = std::function<std::size_t(unsigned, const std::atomic<bool>&, spin_barrier&)>;
+
+auto run(const scenario& body, const unsigned threads, const std::chrono::milliseconds duration) -> double
+{
+  std::atomic<bool> stop{false};
+  std::atomic<std::size_t> operations{0};
+  spin_barrier barrier{threads};
+  std::vector<std::thread> workers;
+
+  const auto start = clock_type::now();
+
+  for(unsigned i = 0; i < threads; i++)
+    workers.emplace_back([&, i] { operations.fetch_add(body(i, stop, barrier), std::memory_order_relaxed); });
+
+  std::this_thread::sleep_for(duration);
+  stop.store(true, std::memory_order_relaxed);
+
+  for(auto& worker : workers)
+    worker.join();
+
+  const std::chrono::duration<double> elapsed = clock_type::now() - start;
+  return operations.load() / elapsed.count();
+}
+
+/*
+ * Round based scenarios agree on end of test at barrier, so no thread waits
+ * for the ones which already left.
+ */
+auto keep_going(const unsigned index, const std::atomic<bool>& stop, std::atomic<bool>& last_round, spin_barrier& barrier) -> bool
+{
+  if(index == 0)
+    last_round.store(stop.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+  barrier.arrive_and_wait();
+  return !last_round.load(std::memory_order_relaxed);
+}
+
+/*
+ * Every thread copies and destroys handles of the same object, so all of them
+ * modify the same reference counter.
+ */
+auto copy_storm() -> scenario
+{
+  const auto source = std::make_shared<const pointer>(csp::make_owned<item>());
+
+  return [source](unsigned, const std::atomic<bool>& stop, spin_barrier&)
+  {
+    std::size_t operations = 0;
+
+    for(; !stop.load(std::memory_order_relaxed); operations++)
+    {
+      const pointer copy = *source;
+      expect(copy.get(std::nothrow) != nullptr, "copy of alive pointer is not null");
+    }
+
+    return operations;
+  };
+}
+
+/*
+ * First thread deletes acquired object, while others call get() on their
+ * copies of pointer. Once get() gives no address, pointer must be expired.
+ */
+auto get_during_deletion() -> scenario
+{
+  struct shared_state
+  {
+    pointer current;
+    std::atomic<bool> last_round{false};
+  };
+
+  const auto shared = std::make_shared<shared_state>();
+
+  return [shared](const unsigned index, const std::atomic<bool>& stop, spin_barrier& barrier)
+  {
+    std::size_t operations = 0;
+
+    while(keep_going(index, stop, shared->last_round, barrier))
+    {
+      std::unique_ptr<item> owner;
+      if(index == 0)
+        shared->current = csp::make_owned<item>(), owner = shared->current.unique_ptr();
+
+      barrier.arrive_and_wait();
+      const pointer copy = shared->current;
+      barrier.arrive_and_wait();
+
+      if(index == 0)
+      {
+        owner.reset();
+        expect(copy.expired(), "pointer is expired after deletion");
+      }
+      else
+      {
+        while(copy.get(std::nothrow))
+          std::this_thread::yield();
+
+        expect(copy.expired(), "pointer without address is expired");
+      }
+
+      barrier.arrive_and_wait();
+      if(index == 0)
+        shared->current = nullptr, operations++;
+    }
+
+    return operations;
+  };
+}
+
+/*
+ * All threads try to acquire the same object, exactly one of them wins.
+ */
+auto racing_acquisitions() -> scenario
+{
+  struct shared_state
+  {
+    pointer current;
+    std::atomic<unsigned> winners{0};
+    std::atomic<bool> last_round{false};
+  };
+
+  const auto shared = std::make_shared<shared_state>();
+
+  return [shared](const unsigned index, const std::atomic<bool>& stop, spin_barrier& barrier)
+  {
+    std::size_t operations = 0;
+
+    while(keep_going(index, stop, shared->last_round, barrier))
+    {
+      if(index == 0)
+        shared->current = csp::make_owned<item>(), shared->winners.store(0, std::memory_order_relaxed);
+
+      barrier.arrive_and_wait();
+
+      try
+      {
+        const auto u = shared->current.unique_ptr();
+        shared->winners.fetch_add(1, std::memory_order_relaxed);
+      }
+      catch(const csp::unique_ptr_already_acquired&)
+      {}
+      catch(const csp::ptr_is_already_deleted&)
+      {}
+
+      barrier.arrive_and_wait();
+
+      if(index == 0)
+      {
+        operations++;
+        expect(shared->winners.load(std::memory_order_relaxed) == 1, "exactly one thread acquires object");
+        expect(shared->current.expired(), "object deleted by winner is expired");
+        shared->current = nullptr;
+      }
+    }
+
+    return operations;
+  };
+}
+
+/*
+ * Pointer moved in from std::unique_ptr has no state yet. Half of threads copy
+ * it, which creates state, while the other half races to acquire object.
+ */
+auto copies_of_moved_in() -> scenario
+{
+  struct shared_state
+  {
+    pointer current;
+    item* address;
+    std::atomic<unsigned> winners{0};
+    std::atomic<bool> last_round{false};
+  };
+
+  const auto shared = std::make_shared<shared_state>();
+
+  return [shared](const unsigned index, const std::atomic<bool>& stop, spin_barrier& barrier)
+  {
+    std::size_t operations = 0;
+
+    while(keep_going(index, stop, shared->last_round, barrier))
+    {
+      if(index == 0)
+      {
+        shared->address = new item{};
+        shared->current = pointer{std::unique_ptr<item>{shared->address}};
+        shared->winners.store(0, std::memory_order_relaxed);
+      }
+
+      barrier.arrive_and_wait();
+
+      std::unique_ptr<item> owner;
+      if(index % 2 == 0)
+      {
+        try
+        {
+          owner = shared->current.unique_ptr();
+          shared->winners.fetch_add(1, std::memory_order_relaxed);
+        }
+        catch(const csp::unique_ptr_already_acquired&)
+        {}
+      }
+      else
+      {
+        const pointer copy = shared->current;
+        expect(copy == shared->address, "copy of moved in pointer holds its object");
+      }
+
+      barrier.arrive_and_wait();
+
+      if(index == 0)
+      {
+        operations++;
+        expect(shared->winners.load(std::memory_order_relaxed) == 1, "exactly one thread acquires moved in object");
+        expect(shared->current.acquired(), "moved in object is acquired");
+        shared->current = nullptr;
+      }
+    }
+
+    return operations;
+  };
+}
+
+void report(const char *const name, const std::function<scenario()>& make, const unsigned max_threads, const std::chrono::milliseconds duration)
+{
+  for(unsigned threads = 1; ; threads *= 2)
+  {
+    threads = threads < max_threads ? threads : max_threads;
+    std::printf("%-20s %8u %16.0f\n", name, threads, run(make(), threads, duration));
+
+    if(threads == max_threads)
+      break;
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  const auto hardware = std::thread::hardware_concurrency();
+  const unsigned max_threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : (hardware ? hardware : 4);
+  const std::chrono::milliseconds duration{argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200};
+
+  std::printf("%-20s %8s %16s\n", "scenario", "threads", "ops/s");
+  report("copy_storm", copy_storm, max_threads, duration);
+  report("get_during_deletion", get_during_deletion, max_threads, duration);
+  report("racing_acquisitions", racing_acquisitions, max_threads, duration);
+  report("copies_of_moved_in", copies_of_moved_in, max_threads, duration);
+
+  return failures.load() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
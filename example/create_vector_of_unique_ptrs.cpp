@@ -1,7 +1,6 @@
 #include "../inc/owned_pointer.hpp"
 #include <iostream>
 #include <cassert>
-#include <algorithm>
 #include <vector>
 
 struct Foo
@@ -15,20 +14,13 @@ int main()
   using namespace ::std;
   using namespace ::csp;
 
-  std::vector<unique_ptr<Foo>> u;
-  std::vector<owned_pointer<Foo>> v(15, nullptr);
-
-  std::generate(v.begin(), v.end(), [](){ return make_owned<Foo>(); });
+  auto v = make_owned_n<Foo>(15);
   std::cout << "---------------------------\n";
 
-  for(auto& e : v)
-    u.push_back(e.unique_ptr());
-
+  auto u = v.acquire_all();
   u.clear();
 
-  v.erase(
-      std::remove_if(v.begin(), v.end(), [](const owned_pointer<Foo>& p) { return p.expired(); }),
-      v.end()
-  );
+  erase_expired(v);
+  assert(v.empty());
   std::cout << "---------------------------\n";
 }
@@ -23,23 +23,66 @@
 **/
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <memory>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 #include <gmock/gmock.h>
 #include "owned_pointer.hpp"
 
 namespace pobu_gmock
 {
 
-template<const int i, const int n, typename T, typename... Args>
-struct nth_arg
-{
-  typedef typename
-      std::conditional< i == n, T, typename nth_arg<i, n + 1, Args...>::type >::type type;
-};
+template<std::size_t... I> struct indices {};
+
+template<typename L, typename R> struct join_indices;
+
+template<std::size_t... L, std::size_t... R>
+struct join_indices<indices<L...>, indices<R...>> { typedef indices<L..., (sizeof...(L) + R)...> type; };
+
+/* Halving keeps depth logarithmic, and sequences are shared by all signatures */
+template<std::size_t n>
+struct make_indices
+    : join_indices<typename make_indices<n / 2>::type, typename make_indices<n - n / 2>::type> {};
+
+template<> struct make_indices<0> { typedef indices<> type; };
+template<> struct make_indices<1> { typedef indices<0> type; };
+
+#if defined(__has_builtin)
+#  if __has_builtin(__type_pack_element)
+#    define POBU_GMOCK_TYPE_PACK_ELEMENT
+#  endif
+#endif
+
+#ifdef POBU_GMOCK_TYPE_PACK_ELEMENT
+
+template<std::size_t i, typename... Args>
+using nth_type = __type_pack_element<i, Args...>;
+
+#else
 
-template<const int i, const int n, typename T>
-struct nth_arg<i, n, T> { typedef T type; };
+template<std::size_t i, typename T> struct indexed { typedef T type; };
+
+template<typename Indices, typename... Args> struct indexed_pack;
+
+template<std::size_t... I, typename... Args>
+struct indexed_pack<indices<I...>, Args...> : indexed<I, Args>... {};
+
+template<std::size_t i, typename T> indexed<i, T> select_indexed(const indexed<i, T>&);
+
+/* One overload resolution per lookup instead of recursion over preceding arguments */
+template<std::size_t i, typename... Args>
+using nth_type = typename decltype(select_indexed<i>(
+    std::declval<const indexed_pack<typename make_indices<sizeof...(Args)>::type, Args...>&>()))::type;
+
+#endif
+
+template<const int i, const int n, typename T, typename... Args>
+struct nth_arg { typedef nth_type<i - n, T, Args...> type; };
 
 template<typename T> T& _forward(T& p) { return p; }
 
@@ -58,7 +101,7 @@ struct func_signature<R(Args...)>
   typedef R result;
 
   constexpr static unsigned int number_of_args = sizeof...(Args);
-  template<const int i> using arg = typename nth_arg<i, 0, Args...>::type;
+  template<const int i> using arg = nth_type<i, Args...>;
 };
 
 template<typename R>
@@ -91,31 +134,202 @@ struct type_info<const std::unique_ptr<T>>
   static const bool is_unique = true;
 };
 
+template<typename T> struct unique_to_owned { typedef T type; };
+template<typename T> struct unique_to_owned<std::unique_ptr<T>> { typedef csp::owned_pointer<T> type; };
+template<typename T> struct unique_to_owned<const std::unique_ptr<T>> { typedef csp::owned_pointer<T> type; };
+
 template<typename T, const bool swap>
 struct mock_func_param_deduction
 {
   static const unsigned int number_of_args = func_signature<T>::number_of_args;
 
-  using result = typename std::conditional
-  <
-    type_info<typename func_signature<T>::result>::is_unique and swap,
-    csp::owned_pointer<
-      typename type_info<typename func_signature<T>::result>::type
-    >,
-    typename func_signature<T>::result
-  >::type;
-
-  template<const int i>
-  using arg = typename std::conditional
-  <
-    type_info<typename func_signature<T>::template arg<i>>::is_unique and swap,
-    csp::owned_pointer<
-      typename type_info<typename func_signature<T>::template arg<i>>::type
-    >,
-    typename func_signature<T>::template arg<i>
-  >::type;
+  using result = typename func_signature<T>::result;
+  template<const int i> using arg = typename func_signature<T>::template arg<i>;
+};
+
+template<typename T>
+struct mock_func_param_deduction<T, true>
+{
+  static const unsigned int number_of_args = func_signature<T>::number_of_args;
+
+  using result = typename unique_to_owned<typename func_signature<T>::result>::type;
+  template<const int i> using arg = typename unique_to_owned<typename func_signature<T>::template arg<i>>::type;
+};
+
+/* Everything MOCK_UNIQUE_METHOD needs from one signature, in one instantiation */
+template<typename T>
+struct unique_method;
+
+template<typename R, typename... Args>
+struct unique_method<R(Args...)>
+{
+  typedef R result;
+  typedef typename unique_to_owned<R>::type mock_signature(typename unique_to_owned<Args>::type...);
+
+  constexpr static unsigned int number_of_args = sizeof...(Args);
+  template<const int i> using arg = nth_type<i, Args...>;
+};
+
+/*
+ * Callable behind STUB_UNIQUE_METHOD. Small trivially copyable callable, like
+ * lambda capturing few pointers or references, is kept inline and called through
+ * one function pointer, so stubbed call takes no lock, no allocation and no
+ * expectation matching. Callable is invoked as const and may be called by many
+ * threads at once, it has to be set before calls start. Stub which was not set
+ * returns value initialized result, like gmock's default action.
+ */
+template<typename T>
+class stub;
+
+template<typename R, typename... Args>
+class stub<R(Args...)>
+{
+public:
+  template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, stub>::value>::type>
+  auto operator=(F&& f) noexcept -> stub&
+  {
+    using callable = typename std::decay<F>::type;
+    static_assert(sizeof(callable) <= sizeof(storage) && alignof(callable) <= alignof(storage_type),
+                  "Callable of stub has to fit in three pointers, capture by reference");
+    static_assert(std::is_trivially_copyable<callable>::value && std::is_trivially_destructible<callable>::value,
+                  "Callable of stub has to be trivially copyable");
+
+    ::new(static_cast<void*>(&storage)) callable(std::forward<F>(f));
+    call = &invoke<callable>;
+    return *this;
+  }
+
+  auto operator()(Args... args) const -> R { return call(&storage, std::forward<Args>(args)...); }
+
+private:
+  using storage_type = typename std::aligned_storage<3 * sizeof(void*), alignof(void*)>::type;
+
+  template<typename F>
+  static auto invoke(const void* f, Args... args) -> R { return (*static_cast<const F*>(f))(std::forward<Args>(args)...); }
+
+  static auto unset(const void*, Args...) -> R { return R(); }
+
+  storage_type storage;
+  R (*call)(const void*, Args...) = &unset;
+};
+
+/*
+ * Action returning objects of batch made in advance, e.g. by make_owned_n, one
+ * per call. Pointer is moved out of its slot, so call takes no reference count
+ * update. Observers of all objects are made up front, so handed out objects can
+ * be checked after test. Copies of action share batch, which is safe to use by
+ * many threads.
+ */
+template<typename T, typename P>
+class return_owned_from_action
+{
+public:
+  using observer_type = csp::owned_observer<T, P>;
+
+  explicit return_owned_from_action(csp::owned_range<T, P> pool) : state{std::make_shared<batch>(std::move(pool))} {}
+
+  template<typename... Args>
+  auto operator()(Args&&...) const -> csp::owned_pointer<T, P>
+  {
+    const auto i = state->next.fetch_add(1, std::memory_order_relaxed);
+
+    if(i < state->pool.size())
+      return std::move(state->pool[i]);
+
+    ADD_FAILURE() << "ReturnOwnedFrom: all " << state->pool.size() << " objects were already returned";
+    return nullptr;
+  }
+
+  auto size() const noexcept -> std::size_t
+  {
+    return std::min(state->next.load(std::memory_order_relaxed), state->pool.size());
+  }
+
+  auto operator[](const std::size_t i) const noexcept -> const observer_type& { return state->observers[i]; }
+
+private:
+  struct batch
+  {
+    explicit batch(csp::owned_range<T, P> p) : pool(std::move(p)), observers(pool.begin(), pool.end()) {}
+
+    csp::owned_range<T, P> pool;
+    const std::vector<observer_type> observers;
+    std::atomic<std::size_t> next{0};
+  };
+
+  std::shared_ptr<batch> state;
+};
+
+/*
+ * Action constructing new object from stored arguments on every call. Object
+ * is made in place by make_owned and returned without copy of its pointer.
+ * Calls are only counted, so action keeps no memory of returned objects and
+ * takes no lock. Observers of first n objects are recorded when asked for by
+ * record(n) before action is used, memory of each observed object stays until
+ * action is gone.
+ */
+template<typename T, typename... Args>
+class return_new_owned_action
+{
+public:
+  using observer_type = csp::owned_observer<T>;
+
+  explicit return_new_owned_action(std::tuple<Args...> args) : state{std::make_shared<record_type>(std::move(args))} {}
+
+  auto record(const std::size_t n) -> return_new_owned_action
+  {
+    state->observers.resize(n);
+    return *this;
+  }
+
+  template<typename... A>
+  auto operator()(A&&...) const -> csp::owned_pointer<T>
+  {
+    auto p = make(typename make_indices<sizeof...(Args)>::type{});
+    const auto i = state->calls.fetch_add(1, std::memory_order_relaxed);
+
+    if(i < state->observers.size())
+      state->observers[i] = p;
+
+    return p;
+  }
+
+  auto size() const noexcept -> std::size_t { return state->calls.load(std::memory_order_relaxed); }
+
+  auto operator[](const std::size_t i) const noexcept -> const observer_type& { return state->observers[i]; }
+
+private:
+  template<std::size_t... I>
+  auto make(indices<I...>) const -> csp::owned_pointer<T>
+  {
+    return csp::make_owned<T>(std::get<I>(state->args)...);
+  }
+
+  struct record_type
+  {
+    explicit record_type(std::tuple<Args...> a) : args(std::move(a)) {}
+
+    const std::tuple<Args...> args;
+    std::atomic<std::size_t> calls{0};
+    std::vector<observer_type> observers;
+  };
+
+  std::shared_ptr<record_type> state;
 };
 
+template<typename T, typename P>
+auto ReturnOwnedFrom(csp::owned_range<T, P> pool) -> return_owned_from_action<T, P>
+{
+  return return_owned_from_action<T, P>{std::move(pool)};
+}
+
+template<typename T, typename... Args>
+auto ReturnNewOwned(Args&&... args) -> return_new_owned_action<T, typename std::decay<Args>::type...>
+{
+  return return_new_owned_action<T, typename std::decay<Args>::type...>{
+      std::tuple<typename std::decay<Args>::type...>{std::forward<Args>(args)...}};
+}
+
 } // namespace pobu_gmock
 
 template<typename T> using s  = pobu_gmock::mock_func_param_deduction<T, true>;
@@ -674,3 +888,91 @@ public:\
                                                       s<signature>::arg<9>))
 
 //-----------------------------------------------------------------------------------------------------------
+
+/*
+ * MOCK_UNIQUE_METHOD(ret, name, (args...), (specs...)) follows gmock's MOCK_METHOD: any number of
+ * arguments gmock supports, types with commas in parentheses, and const, override, final, noexcept,
+ * ref(...) and Calltype(...) in specs. Specs apply to the generated member function, while the mocked
+ * _name only inherits const.
+ */
+#define MOCK_UNIQUE_METHOD(...) \
+  GMOCK_PP_VARIADIC_CALL(POBU_GMOCK_UNIQUE_METHOD_ARG_, __VA_ARGS__)
+
+#define POBU_GMOCK_UNIQUE_METHOD_ARG_1(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+#define POBU_GMOCK_UNIQUE_METHOD_ARG_2(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+
+#define POBU_GMOCK_UNIQUE_METHOD_ARG_3(ret, name, args) \
+  POBU_GMOCK_UNIQUE_METHOD_ARG_4(ret, name, args, ())
+
+#define POBU_GMOCK_UNIQUE_METHOD_ARG_4(ret, name, args, specs) \
+  POBU_GMOCK_UNIQUE_DECLARE(POBU_GMOCK_UNIQUE_MOCKER, ret, name, args, specs)
+
+#define POBU_GMOCK_UNIQUE_METHOD_ARG_5(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+#define POBU_GMOCK_UNIQUE_METHOD_ARG_6(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+#define POBU_GMOCK_UNIQUE_METHOD_ARG_7(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+
+/*
+ * STUB_UNIQUE_METHOD(ret, name, (args...), (specs...)) is declared like MOCK_UNIQUE_METHOD and
+ * generates the same member function, but _name is pobu_gmock::stub instead of gmock mocker. Assign
+ * callable taking owned_pointer to it, e.g. _create = [] { return csp::make_owned<item>(); }; calls
+ * bypass gmock completely, for throughput tests where expectations are not needed.
+ */
+#define STUB_UNIQUE_METHOD(...) \
+  GMOCK_PP_VARIADIC_CALL(POBU_GMOCK_UNIQUE_STUB_ARG_, __VA_ARGS__)
+
+#define POBU_GMOCK_UNIQUE_STUB_ARG_1(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+#define POBU_GMOCK_UNIQUE_STUB_ARG_2(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+
+#define POBU_GMOCK_UNIQUE_STUB_ARG_3(ret, name, args) \
+  POBU_GMOCK_UNIQUE_STUB_ARG_4(ret, name, args, ())
+
+#define POBU_GMOCK_UNIQUE_STUB_ARG_4(ret, name, args, specs) \
+  POBU_GMOCK_UNIQUE_DECLARE(POBU_GMOCK_UNIQUE_STUB, ret, name, args, specs)
+
+#define POBU_GMOCK_UNIQUE_STUB_ARG_5(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+#define POBU_GMOCK_UNIQUE_STUB_ARG_6(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+#define POBU_GMOCK_UNIQUE_STUB_ARG_7(...) GMOCK_INTERNAL_WRONG_ARITY(__VA_ARGS__)
+
+#define POBU_GMOCK_UNIQUE_DECLARE(callee, ret, name, args, specs) \
+  GMOCK_INTERNAL_ASSERT_PARENTHESIS(args); \
+  GMOCK_INTERNAL_ASSERT_PARENTHESIS(specs); \
+  GMOCK_INTERNAL_ASSERT_VALID_SPEC(specs) \
+  private:\
+  typedef pobu_gmock::unique_method<GMOCK_INTERNAL_SIGNATURE(ret, args)> POBU_GMOCK_UNIQUE_TRAITS(name);\
+  POBU_GMOCK_UNIQUE_METHOD_IMPL(GMOCK_PP_NARG0 args, name, \
+                                GMOCK_INTERNAL_HAS_CONST(specs), \
+                                GMOCK_INTERNAL_HAS_OVERRIDE(specs), \
+                                GMOCK_INTERNAL_HAS_FINAL(specs), \
+                                GMOCK_INTERNAL_GET_NOEXCEPT_SPEC(specs), \
+                                GMOCK_INTERNAL_GET_CALLTYPE_SPEC(specs), \
+                                GMOCK_INTERNAL_GET_REF_SPEC(specs), \
+                                POBU_GMOCK_UNIQUE_TRAITS(name), callee)
+
+/* Short per-method name of the traits, so the signature is spelled once and not once per argument */
+#define POBU_GMOCK_UNIQUE_TRAITS(name) GTEST_CONCAT_TOKEN_(pobu_gmock_unique_ ## name ## _, __LINE__)
+
+#define POBU_GMOCK_UNIQUE_METHOD_IMPL(n, name, constness, override_, final_, noexcept_, calltype, ref, traits, callee) \
+static_assert(traits::number_of_args == n, \
+              "Not proper arguments number, parenthesize all types with unprotected commas");\
+typename traits::result GMOCK_INTERNAL_EXPAND(calltype) \
+name(GMOCK_PP_REPEAT(POBU_GMOCK_UNIQUE_PARAMETER, traits, n)) \
+  GMOCK_PP_IF(constness, const, ) ref noexcept_ GMOCK_PP_IF(override_, override, ) GMOCK_PP_IF(final_, final, ) \
+{ \
+  return static_cast<typename traits::result>(_ ## name(GMOCK_PP_REPEAT(POBU_GMOCK_UNIQUE_FORWARD, , n))); \
+}\
+public:\
+  callee(n, _ ## name, constness, traits)
+
+#define POBU_GMOCK_UNIQUE_MOCKER(n, name, constness, traits) \
+  GMOCK_INTERNAL_MOCK_METHOD_IMPL(n, name, constness, 0, 0, , , , (typename traits::mock_signature))
+
+#define POBU_GMOCK_UNIQUE_STUB(n, name, constness, traits) \
+  pobu_gmock::stub<typename traits::mock_signature> name
+
+#define POBU_GMOCK_UNIQUE_PARAMETER(i, traits, _) \
+  GMOCK_PP_COMMA_IF(i) typename traits::template arg<i> a ## i
+
+#define POBU_GMOCK_UNIQUE_FORWARD(i, _1, _2) \
+  GMOCK_PP_COMMA_IF(i) pobu_gmock::_forward(a ## i)
+
+//-----------------------------------------------------------------------------------------------------------
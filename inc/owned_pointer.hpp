@@ -24,20 +24,313 @@
 #pragma once
 
 #include <new>
-#include <tuple>
+#include <atomic>
 #include <memory>
+#include <cstdint>
+#include <cstddef>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+#include <iterator>
+#include <vector>
 #include <exception>
+#include <stdexcept>
+#include <functional>
 #include <type_traits>
 
+#ifndef OWNED_POINTER_RTTI
+#  if defined(__GXX_RTTI) || defined(_CPPRTTI) || defined(__cpp_rtti)
+#    define OWNED_POINTER_RTTI 1
+#  else
+#    define OWNED_POINTER_RTTI 0
+#  endif
+#endif
+
+#ifdef OWNED_POINTER_TRACING
+#  include <chrono>
+#  ifndef OWNED_POINTER_TRACE_CAPACITY
+#    define OWNED_POINTER_TRACE_CAPACITY 65536
+#  endif
+#endif
+
+#ifdef OWNED_POINTER_DELETE_HOOK
+#  ifndef OWNED_POINTER_REGISTRY
+#    define OWNED_POINTER_REGISTRY
+#  endif
+#endif
+
+/* Without RTTI object given back by unique_ptr finds its block only by address */
+#if !OWNED_POINTER_RTTI
+#  ifndef OWNED_POINTER_REGISTRY
+#    define OWNED_POINTER_REGISTRY
+#  endif
+#endif
+
+#if defined(OWNED_POINTER_STATISTICS) || defined(OWNED_POINTER_SITE_REPORT) || defined(OWNED_POINTER_TRACING) || \
+    defined(OWNED_POINTER_REGISTRY)
+#  include <mutex>
+#endif
+
+#ifdef OWNED_POINTER_REGISTRY
+#  include <unordered_map>
+#  ifndef OWNED_POINTER_REGISTRY_SHARDS
+#    define OWNED_POINTER_REGISTRY_SHARDS 64
+#  endif
+#  ifndef OWNED_POINTER_REGISTRY_FILTER
+#    define OWNED_POINTER_REGISTRY_FILTER 262144
+#  endif
+#endif
+
+#ifndef OWNED_POINTER_BLOCK_POOL
+#  define OWNED_POINTER_BLOCK_POOL 64
+#endif
+
+#ifndef OWNED_POINTER_PREFETCH
+#  if defined(__GNUC__) || defined(__clang__)
+#    define OWNED_POINTER_PREFETCH(address, write) __builtin_prefetch((address), (write))
+#  else
+#    define OWNED_POINTER_PREFETCH(address, write) ((void)(address))
+#  endif
+#endif
+
+/*
+ * Defines below change layout of control block and bodies of inline functions,
+ * so they have to be the same in every translation unit. Library is placed in
+ * inline namespace named after them, so units built with different defines
+ * fail to link when owned_pointer is in signature of function they share.
+ * Other mismatches are found when program starts, see configuration_check.
+ */
+#ifdef OWNED_POINTER_STATISTICS
+#  define OWNED_POINTER_CONFIG_STATISTICS 1
+#else
+#  define OWNED_POINTER_CONFIG_STATISTICS 0
+#endif
+#ifdef OWNED_POINTER_SITE_REPORT
+#  define OWNED_POINTER_CONFIG_SITE_REPORT 1
+#else
+#  define OWNED_POINTER_CONFIG_SITE_REPORT 0
+#endif
+#ifdef OWNED_POINTER_TRACING
+#  define OWNED_POINTER_CONFIG_TRACING 1
+#else
+#  define OWNED_POINTER_CONFIG_TRACING 0
+#endif
+#ifdef OWNED_POINTER_REGISTRY
+#  define OWNED_POINTER_CONFIG_REGISTRY 1
+#else
+#  define OWNED_POINTER_CONFIG_REGISTRY 0
+#endif
+#ifdef OWNED_POINTER_DELETE_HOOK
+#  define OWNED_POINTER_CONFIG_DELETE_HOOK 1
+#else
+#  define OWNED_POINTER_CONFIG_DELETE_HOOK 0
+#endif
+
+#define OWNED_POINTER_CONFIG_NAMESPACE_(s, p, t, r, h) config_ ## s ## p ## t ## r ## h
+#define OWNED_POINTER_CONFIG_NAMESPACE(s, p, t, r, h) OWNED_POINTER_CONFIG_NAMESPACE_(s, p, t, r, h)
+#define OWNED_POINTER_CONFIG (OWNED_POINTER_CONFIG_STATISTICS | OWNED_POINTER_CONFIG_SITE_REPORT << 1 | \
+                              OWNED_POINTER_CONFIG_TRACING << 2 | OWNED_POINTER_CONFIG_REGISTRY << 3 | \
+                              OWNED_POINTER_CONFIG_DELETE_HOOK << 4)
+
 namespace csp
 {
+inline namespace OWNED_POINTER_CONFIG_NAMESPACE(OWNED_POINTER_CONFIG_STATISTICS, OWNED_POINTER_CONFIG_SITE_REPORT,
+                                                OWNED_POINTER_CONFIG_TRACING, OWNED_POINTER_CONFIG_REGISTRY,
+                                                OWNED_POINTER_CONFIG_DELETE_HOOK)
+{
+
+/*
+ * Threading policies of owned_pointer. Both of them use the same control block,
+ * they differ only in the way reference counter and state are modified.
+ */
+struct thread_safe
+{
+  template<typename T>
+  static auto load(const std::atomic<T>& a, const std::memory_order order) noexcept -> T
+  {
+    return a.load(order);
+  }
+
+  template<typename T>
+  static auto fetch_add(std::atomic<T>& a, const T v, const std::memory_order order) noexcept -> T
+  {
+    return a.fetch_add(v, order);
+  }
+
+  template<typename T>
+  static auto fetch_sub(std::atomic<T>& a, const T v, const std::memory_order order) noexcept -> T
+  {
+    return a.fetch_sub(v, order);
+  }
+
+  template<typename T>
+  static auto fetch_or(std::atomic<T>& a, const T v, const std::memory_order order) noexcept -> T
+  {
+    return a.fetch_or(v, order);
+  }
+
+  template<typename T>
+  static auto fetch_and(std::atomic<T>& a, const T v, const std::memory_order order) noexcept -> T
+  {
+    return a.fetch_and(v, order);
+  }
+
+  template<typename T>
+  static auto compare_exchange(std::atomic<T>& a, T& expected, const T desired, const std::memory_order order) noexcept -> bool
+  {
+    return a.compare_exchange_weak(expected, desired, order, std::memory_order_relaxed);
+  }
+};
+
+/*
+ * Reference counter and state are updated by plain load and store, so no locked
+ * instruction is emitted. All copies of such owned_pointer have to be used by
+ * single thread.
+ */
+struct single_threaded
+{
+  template<typename T>
+  static auto load(const std::atomic<T>& a, std::memory_order) noexcept -> T
+  {
+    return a.load(std::memory_order_relaxed);
+  }
+
+  template<typename T>
+  static auto fetch_add(std::atomic<T>& a, const T v, std::memory_order) noexcept -> T
+  {
+    const auto old = a.load(std::memory_order_relaxed);
+    return a.store(static_cast<T>(old + v), std::memory_order_relaxed), old;
+  }
+
+  template<typename T>
+  static auto fetch_sub(std::atomic<T>& a, const T v, std::memory_order) noexcept -> T
+  {
+    const auto old = a.load(std::memory_order_relaxed);
+    return a.store(static_cast<T>(old - v), std::memory_order_relaxed), old;
+  }
+
+  template<typename T>
+  static auto fetch_or(std::atomic<T>& a, const T v, std::memory_order) noexcept -> T
+  {
+    const auto old = a.load(std::memory_order_relaxed);
+    return a.store(static_cast<T>(old | v), std::memory_order_relaxed), old;
+  }
+
+  template<typename T>
+  static auto fetch_and(std::atomic<T>& a, const T v, std::memory_order) noexcept -> T
+  {
+    const auto old = a.load(std::memory_order_relaxed);
+    return a.store(static_cast<T>(old & v), std::memory_order_relaxed), old;
+  }
+
+  template<typename T>
+  static auto compare_exchange(std::atomic<T>& a, T& expected, const T desired, std::memory_order) noexcept -> bool
+  {
+    const auto current = a.load(std::memory_order_relaxed);
+
+    if(current != expected)
+      return expected = current, false;
+
+    return a.store(desired, std::memory_order_relaxed), true;
+  }
+};
+
+/*
+ * Checking of access policies. get(), operator-> and operator* throw, when
+ * object was already deleted by unique_ptr. Check can be kept only in debug
+ * build or dropped completely, e.g. for hot loops of tests. Types without
+ * virtual dtor are checked too, their deletion is seen only when they were
+ * acquired with tracked_unique_ptr() or deletion hook is used.
+ */
+enum class access_check
+{
+  checked,
+  debug_checked,
+  unchecked
+};
+
+template<typename Threading = thread_safe>
+struct debug_checked : Threading
+{
+  static constexpr access_check access = access_check::debug_checked;
+};
+
+template<typename Threading = thread_safe>
+struct unchecked : Threading
+{
+  static constexpr access_check access = access_check::unchecked;
+};
 
 namespace _priv
 {
 template<typename> class link_ptr;
+
+enum lifecycle_event : unsigned char
+{
+  created_event,
+  acquired_event,
+  expired_event,
+  never_acquired_event,
+  lifecycle_events,
+  copied_event = lifecycle_events // traced, but not counted
+};
+
+/* Counters of other threads are read without lock, so their difference can be briefly negative */
+inline auto counted_difference(const std::size_t a, const std::size_t b) noexcept -> std::size_t
+{
+  return a > b ? a - b : 0;
+}
 }
 
+/*
+ * Place in code, where objects are created. Use OWNED_POINTER_SITE to get
+ * site of current line. With OWNED_POINTER_SITE_REPORT every site counts
+ * lifecycle events of its objects, otherwise it is just file and line.
+ */
+struct allocation_site
+{
+#ifdef OWNED_POINTER_SITE_REPORT
+  allocation_site(const char* f, unsigned l) noexcept;
+
+  std::atomic<std::size_t> events[_priv::lifecycle_events];
+  allocation_site* next;
+#else
+  constexpr allocation_site(const char *const f, const unsigned l) noexcept : file(f), line(l) {}
+#endif
+
+  const char* file;
+  unsigned line;
+};
+
+#ifdef OWNED_POINTER_DELETE_HOOK
+/*
+ * Replaces global operator new and delete, so deletion of any object created
+ * by make_owned or linked to owned_pointer is detected. Must be used in exactly
+ * one translation unit of program. New is replaced as well, so both of them
+ * use malloc and stay paired, also under sanitizers.
+ */
+#  if defined(__cpp_sized_deallocation)
+#    define OWNED_POINTER_SIZED_OPERATOR_DELETE \
+       void operator delete(void *const p, std::size_t) noexcept { ::operator delete(p); }
+#  else
+#    define OWNED_POINTER_SIZED_OPERATOR_DELETE
+#  endif
+
+#  define OWNED_POINTER_DEFINE_DELETE_HOOK() \
+     void* operator new(const std::size_t size) { return ::csp::_priv::allocate_for_delete_hook(size); } \
+     void* operator new(const std::size_t size, const std::nothrow_t&) noexcept \
+     { \
+       try { return ::csp::_priv::allocate_for_delete_hook(size); } catch(...) { return nullptr; } \
+     } \
+     void operator delete(void *const p) noexcept { ::csp::_priv::notify_operator_delete(p); std::free(p); } \
+     void operator delete(void *const p, const std::nothrow_t&) noexcept { ::operator delete(p); } \
+     OWNED_POINTER_SIZED_OPERATOR_DELETE
+#endif
+
+#define OWNED_POINTER_SITE \
+  ([]() noexcept -> ::csp::allocation_site& { static ::csp::allocation_site site{__FILE__, __LINE__}; return site; }())
+
 template<typename T>
 auto link(const std::unique_ptr<T>& u) noexcept -> _priv::link_ptr<T>;
 
@@ -47,420 +340,2603 @@ auto link(const std::unique_ptr<T>& u) noexcept -> _priv::link_ptr<R>;
 namespace _priv
 {
 
-using control_block_type = std::tuple<void*, bool, bool>;
+struct control_block;
+inline void register_block(control_block* cb) noexcept;
+inline void unregister_block(control_block* cb) noexcept;
 
-const auto ptr      = +[](control_block_type& cb) -> void* { return std::get<0>(cb); };
-const auto deleted  = +[](control_block_type& cb) -> bool& { return std::get<2>(cb); };
-const auto acquired = +[](control_block_type& cb) -> bool& { return std::get<1>(cb); };
+#ifdef OWNED_POINTER_STATISTICS
+/*
+ * Lifecycle counters of one type in one thread. Only owning thread modifies
+ * them, so plain load and store are enough and snapshot reads them under lock.
+ */
+struct thread_counters
+{
+  std::atomic<std::size_t> events[lifecycle_events];
+  thread_counters* next;
+  thread_counters* prev;
+};
 
-template<typename T>
-struct owned_deleter
+struct type_statistics
 {
-  void operator()(control_block_type *const cb)
+  std::size_t object_size;
+  thread_counters& (*local)() noexcept;
+  type_statistics* next;
+  thread_counters* threads;
+  std::size_t retired[lifecycle_events];
+  bool registered;
+};
+
+struct statistics_registry
+{
+  std::mutex lock;
+  type_statistics* types;
+
+  static auto instance() noexcept -> statistics_registry&
   {
-#ifdef OWNED_POINTER_ASSERT_DTOR
-    assert(acquired(*cb) && "ASSERT: you created owned_pointer, but unique_ptr was never acquired");
-#else
-    if(!acquired(*cb))
-      delete static_cast<T*>(ptr(*cb));
-#endif
-    delete cb;
+    static statistics_registry registry{};
+    return registry;
   }
 };
 
-class shared_secret
+/*
+ * Registers counters of current thread on first use and moves them to retired
+ * ones of its type, when thread exits.
+ */
+class thread_slot : public thread_counters
 {
 public:
-  std::weak_ptr<control_block_type> control_block;
-  virtual ~shared_secret() = default;
+  explicit thread_slot(type_statistics& t) noexcept : thread_counters{}, type(t)
+  {
+    auto& registry = statistics_registry::instance();
+    std::lock_guard<std::mutex> guard{registry.lock};
 
-protected:
-  void delete_event() noexcept
+    if(!type.registered)
+      type.next = registry.types, registry.types = &type, type.registered = true;
+
+    next = type.threads;
+    if(next)
+      next->prev = this;
+    type.threads = this;
+  }
+
+  ~thread_slot()
   {
-    if(auto p{control_block.lock()}) deleted(*p) = true;
+    std::lock_guard<std::mutex> guard{statistics_registry::instance().lock};
+
+    for(unsigned e = 0; e < lifecycle_events; e++)
+      type.retired[e] += events[e].load(std::memory_order_relaxed);
+
+    (prev ? prev->next : type.threads) = next;
+    if(next)
+      next->prev = prev;
   }
+
+private:
+  type_statistics& type;
 };
 
+template<typename Base> struct destruction_notify_object;
+
+template<typename T>
+struct statistics_key { using type = T; };
+
 template<typename Base>
-struct destruction_notify_object : Base, shared_secret
+struct statistics_key<destruction_notify_object<Base>> { using type = Base; };
+
+template<typename T>
+struct statistics_of
 {
-   using Base::Base;
-   ~destruction_notify_object() override { delete_event(); }
+  static auto local() noexcept -> thread_counters&
+  {
+    static thread_local thread_slot slot{instance};
+    return slot;
+  }
+
+  static type_statistics instance;
 };
 
 template<typename T>
-class link_ptr
+type_statistics statistics_of<T>::instance{sizeof(T), &statistics_of<T>::local, nullptr, nullptr, {}, false};
+#endif
+
+struct block_operations
 {
-public:
-  template<typename R>
-  explicit link_ptr(const std::unique_ptr<R>& u) noexcept : ptr{u.get()} {}
+  void (*dispose)(control_block*) noexcept;
+  void (*destroy)(control_block*) noexcept;
+  void (*deallocate)(control_block*) noexcept;
+#ifdef OWNED_POINTER_STATISTICS
+  type_statistics* statistics;
+#endif
+};
 
-  link_ptr(const link_ptr&) = delete;
-  link_ptr(link_ptr&&) noexcept = default;
-  link_ptr& operator=(link_ptr&&) = delete;
-  link_ptr& operator=(const link_ptr&) = delete;
+/*
+ * Operations of control block, which tracks object created as Object.
+ */
+template<typename Object, typename Layout>
+constexpr auto operations_of() noexcept -> block_operations
+{
+#ifdef OWNED_POINTER_STATISTICS
+  return {&Layout::dispose, &Layout::destroy, &Layout::deallocate,
+          &statistics_of<typename statistics_key<Object>::type>::instance};
+#else
+  return {&Layout::dispose, &Layout::destroy, &Layout::deallocate};
+#endif
+}
 
-  auto get() const noexcept -> T* { return ptr; }
+/*
+ * Intrusive control block shared by all copies of owned_pointer. Reference
+ * counter, ownership state and object address live together, so handle is
+ * single pointer. Weak counter holds memory of block: one reference for all
+ * owned_pointers and one for every notification link or object stored inline.
+ * Every modifying operation is parametrized by threading policy of the caller.
+ */
+struct control_block
+{
+  control_block(void *const p, const block_operations& ops, const unsigned weak_refs) noexcept
+    : refs{1}, weak{weak_refs}, ptr{p}, operations{&ops}, state{0}
+  {}
+
+  static constexpr unsigned char acquired_flag = 1;
+  static constexpr unsigned char deleted_flag  = 2;
+  static constexpr unsigned char linked_flag   = 4;
+  static constexpr unsigned char registered_flag = 8;
+  static constexpr unsigned char ever_acquired_flag = 16;
+  static constexpr unsigned char in_place_flag = 32;
+
+  /* Object stored in place of its block can be freed only by tracking_deleter */
+  static constexpr unsigned char refused_by_tracked = acquired_flag | deleted_flag;
+  static constexpr unsigned char refused_by_unique = refused_by_tracked | in_place_flag;
+
+  template<typename Policy = thread_safe>
+  auto acquired() const noexcept -> bool
+  {
+    return Policy::load(state, std::memory_order_acquire) & acquired_flag;
+  }
 
-private:
-  T* const ptr;
-};
+  template<typename Policy = thread_safe>
+  auto deleted() const noexcept -> bool
+  {
+    return Policy::load(state, std::memory_order_acquire) & deleted_flag;
+  }
 
-template<typename T>
-struct is_expired_enabled :
-  std::integral_constant<bool, std::has_virtual_destructor<T>::value
-                                #if __cplusplus >= 201402L
-                                  && !std::is_final<T>::value
-                                #endif
-                        > {};
+  template<typename Policy = thread_safe>
+  void set_acquired(const bool value) noexcept
+  {
+    if(value)
+      Policy::fetch_or(state, acquired_flag, std::memory_order_acq_rel);
+    else
+      Policy::fetch_and(state, static_cast<unsigned char>(~acquired_flag), std::memory_order_acq_rel);
+  }
 
-} // namespace _priv
+  template<typename Policy = thread_safe>
+  auto linked() const noexcept -> bool
+  {
+    return Policy::load(state, std::memory_order_acquire) & linked_flag;
+  }
 
-template<typename Tp>
-class owned_pointer : std::shared_ptr<_priv::control_block_type>
-{
-  static_assert(!std::is_array<Tp>::value && !std::is_pointer<Tp>::value, "no array nor pointer supported");
-  using base_type = std::shared_ptr<_priv::control_block_type>;
+  template<typename Policy = thread_safe>
+  void mark_linked() noexcept
+  {
+    Policy::fetch_or(state, linked_flag, std::memory_order_release);
+  }
 
-#ifdef OWNED_POINTER_STRICT_SAFETY
-  static_assert(
-      _priv::is_expired_enabled<Tp>::value,
-      "This type is not strictly safe to use with owned_pointer");
-#endif
+  /*
+   * Object is being deleted by its single owner, so nobody else can modify
+   * state concurrently and plain store publishes deletion.
+   */
+  void mark_deleted_by_owner() noexcept
+  {
+    state.store(state.load(std::memory_order_relaxed) | deleted_flag, std::memory_order_release);
+  }
 
-  template<typename>
-  friend class owned_pointer;
+  /*
+   * Exactly one caller wins acquisition of object. Returned state is the one
+   * observed by compare exchange, so loser knows why it lost.
+   */
+  template<typename Policy = thread_safe>
+  auto try_acquire(const unsigned char refused = refused_by_unique) noexcept -> unsigned char
+  {
+    auto expected = Policy::load(state, std::memory_order_acquire);
 
-public:
-  using element_type = Tp;
-  using base_type::use_count;
-  using uptr_type = std::unique_ptr<element_type>;
+    while(!(expected & refused))
+      if(Policy::compare_exchange(state, expected, static_cast<unsigned char>(expected | acquired_flag),
+                                  std::memory_order_acq_rel))
+        return expected;
 
-  constexpr owned_pointer() noexcept = default;
-  constexpr owned_pointer(std::nullptr_t) noexcept {}
+    return expected;
+  }
 
-  template<typename T>
-  owned_pointer(_priv::link_ptr<T>&& p) : owned_pointer(p.get(), true) {}
+  template<typename Policy = thread_safe>
+  void add_ref() noexcept
+  {
+    Policy::fetch_add(refs, 1u, std::memory_order_relaxed);
+  }
 
-  template<typename T>
-  owned_pointer(std::unique_ptr<T>&& p) : owned_pointer(p.release(), false) {}
+  template<typename Policy = thread_safe>
+  auto try_add_ref() noexcept -> bool
+  {
+    auto count = Policy::load(refs, std::memory_order_relaxed);
 
-  auto get() const -> element_type*;
-  explicit operator uptr_type() const;
-  auto unique_ptr() const -> uptr_type;
-  auto expired() const noexcept -> bool;
-  auto raw_ptr() const -> element_type*;
-  auto acquired() const noexcept -> bool;
-  explicit operator bool() const noexcept;
-  auto operator*() const -> element_type&;
-  auto operator->() const -> element_type*;
-  auto get(std::nothrow_t) const noexcept -> element_type*;
+    while(count != 0)
+      if(Policy::compare_exchange(refs, count, count + 1, std::memory_order_acq_rel))
+        return true;
 
-  template<typename X = element_type>
-  auto begin() const -> decltype(std::declval<X>().begin()) { return get()->begin(); }
-  
-  template<typename X = element_type>
-  auto end() const -> decltype(std::declval<X>().end()) { return get()->end(); }
-  
-  template<typename X = element_type>
-  auto cbegin() const -> decltype(std::declval<X>().cbegin()) { return get()->cbegin(); }
-  
-  template<typename X = element_type>
-  auto cend() const -> decltype(std::declval<X>().cend()) { return get()->end(); }
+    return false;
+  }
 
-  template<typename X = element_type>
-  auto size() const -> decltype(std::declval<X>().size()) { return get()->size(); }
-  
-  template<typename T>
-  operator owned_pointer<T>() const noexcept;
+  /*
+   * Like try_add_ref, but block, whose last owned_pointer is gone while object
+   * was acquired, is given back to owners instead of failing. Caller holds the
+   * object, so its link or tracking deleter still keeps block in memory.
+   */
+  template<typename Policy = thread_safe>
+  void add_ref_or_revive() noexcept
+  {
+    auto count = Policy::load(refs, std::memory_order_relaxed);
 
-  template<typename T>
-  auto compare(const T& ptr) const noexcept -> std::int8_t;
+    while(!Policy::compare_exchange(refs, count, count + 1, std::memory_order_acq_rel));
+
+    if(count == 0)
+    {
+      add_weak<Policy>();
+
+      if(!(Policy::load(state, std::memory_order_acquire) & registered_flag))
+        register_block(this);
+    }
+  }
+
+  /*
+   * Linked object held by unique_ptr outlives owners of its block, so block
+   * stays registered and can be given back by address, until object is deleted.
+   */
+  template<typename Policy = thread_safe>
+  void release() noexcept
+  {
+    if(Policy::fetch_sub(refs, 1u, std::memory_order_acq_rel) == 1)
+    {
+      if((Policy::load(state, std::memory_order_acquire) & (linked_flag | acquired_flag)) != (linked_flag | acquired_flag))
+        unregister_block(this);
+
+      operations->dispose(this);
+      release_weak<Policy>();
+    }
+  }
+
+  template<typename Policy = thread_safe>
+  void add_weak() noexcept
+  {
+    Policy::fetch_add(weak, 1u, std::memory_order_relaxed);
+  }
+
+  template<typename Policy = thread_safe>
+  void release_weak() noexcept
+  {
+    if(Policy::fetch_sub(weak, 1u, std::memory_order_acq_rel) == 1)
+      operations->deallocate(this);
+  }
+
+  std::atomic<unsigned> refs;
+  std::atomic<unsigned> weak;
+  void* ptr;
+  const block_operations* operations;
+  std::atomic<unsigned char> state;
+#ifdef OWNED_POINTER_SITE_REPORT
+  allocation_site* site{nullptr};
+#endif
+};
+
+#ifdef OWNED_POINTER_REGISTRY
+/*
+ * Registry allocates its nodes with malloc, so it can be used from inside of
+ * replaced operator delete.
+ */
+template<typename T>
+struct registry_allocator
+{
+  using value_type = T;
+
+  registry_allocator() = default;
+  template<typename U>
+  registry_allocator(const registry_allocator<U>&) noexcept {}
+
+  auto allocate(const std::size_t n) -> T*
+  {
+    if(const auto p = std::malloc(n * sizeof(T)))
+      return static_cast<T*>(p);
+
+    throw std::bad_alloc{};
+  }
+
+  void deallocate(T *const p, std::size_t) noexcept
+  {
+    std::free(p);
+  }
+
+  template<typename U>
+  auto operator==(const registry_allocator<U>&) const noexcept -> bool { return true; }
+
+  template<typename U>
+  auto operator!=(const registry_allocator<U>&) const noexcept -> bool { return false; }
+};
+
+/*
+ * Map from address of object to control block, which tracks it. Table is split
+ * into shards with their own locks, so threads passing different objects
+ * rarely meet. Entry does not hold block, it is erased before last owner
+ * releases block, so block found under lock is always valid. In front of the
+ * table counting filter tells without any lock, that address is surely not
+ * registered, which is the common case of every operator delete.
+ */
+constexpr std::size_t registry_shards = OWNED_POINTER_REGISTRY_SHARDS;
+static_assert((registry_shards & (registry_shards - 1)) == 0, "number of registry shards must be power of two");
+
+constexpr std::size_t registry_filter_size = OWNED_POINTER_REGISTRY_FILTER;
+static_assert((registry_filter_size & (registry_filter_size - 1)) == 0, "size of registry filter must be power of two");
+
+template<typename = void>
+struct registry_filter
+{
+  static auto of(const void *const p) noexcept -> std::atomic<unsigned>&
+  {
+    const auto address = reinterpret_cast<std::uintptr_t>(p);
+    return counts[((address >> 4) ^ (address >> 20)) & (registry_filter_size - 1)];
+  }
+
+  static std::atomic<unsigned> counts[registry_filter_size];
+};
+
+template<typename T>
+std::atomic<unsigned> registry_filter<T>::counts[registry_filter_size];
+
+using registry_map = std::unordered_map<const void*, control_block*, std::hash<const void*>, std::equal_to<const void*>,
+                                        registry_allocator<std::pair<const void *const, control_block*>>>;
+
+struct alignas(64) registry_shard
+{
+  void add(const void *const p, control_block *const cb)
+  {
+    const auto inserted = blocks.emplace(p, cb);
+
+    if(inserted.second)
+      registry_filter<>::of(p).fetch_add(1, std::memory_order_relaxed);
+    else
+      inserted.first->second = cb; // replaces block of object, which was deleted unnoticed
+  }
+
+  void remove(const registry_map::iterator it) noexcept
+  {
+    registry_filter<>::of(it->first).fetch_sub(1, std::memory_order_relaxed);
+    blocks.erase(it);
+  }
+
+  std::mutex lock;
+  registry_map blocks;
+};
+
+struct block_registry
+{
+  static auto instance() noexcept -> block_registry&
+  {
+    // never destroyed, because objects may outlive static destructors
+    static typename std::aligned_storage<sizeof(block_registry), alignof(block_registry)>::type storage;
+    static block_registry *const registry = ::new(static_cast<void*>(&storage)) block_registry{};
+    return *registry;
+  }
+
+  static auto may_contain(const void *const p) noexcept -> bool
+  {
+    return registry_filter<>::of(p).load(std::memory_order_relaxed) != 0;
+  }
+
+  auto shard_of(const void *const p) noexcept -> registry_shard&
+  {
+    const auto address = reinterpret_cast<std::uintptr_t>(p);
+    return shards[((address >> 4) ^ (address >> 12)) & (registry_shards - 1)];
+  }
+
+  registry_shard shards[registry_shards];
+};
+#endif
+
+/*
+ * Makes object of control block findable by its address. Compiles to nothing,
+ * unless OWNED_POINTER_REGISTRY is defined.
+ */
+inline void register_block(control_block *const cb) noexcept
+{
+#ifdef OWNED_POINTER_REGISTRY
+  auto& shard = block_registry::instance().shard_of(cb->ptr);
+  cb->state.fetch_or(control_block::registered_flag, std::memory_order_acq_rel);
+
+  std::lock_guard<std::mutex> guard{shard.lock};
+  shard.add(cb->ptr, cb);
+#else
+  (void)cb;
+#endif
+}
+
+inline void unregister_block(control_block *const cb) noexcept
+{
+#ifdef OWNED_POINTER_REGISTRY
+  if(!(cb->state.fetch_and(static_cast<unsigned char>(~control_block::registered_flag), std::memory_order_acq_rel) &
+       control_block::registered_flag))
+    return;
+
+  auto& shard = block_registry::instance().shard_of(cb->ptr);
+  std::lock_guard<std::mutex> guard{shard.lock};
+  const auto it = shard.blocks.find(cb->ptr);
+
+  if(it != shard.blocks.end() && it->second == cb)
+    shard.remove(it);
+#else
+  (void)cb;
+#endif
+}
+
+/*
+ * Returns referenced control block of object with given address or nullptr,
+ * when object is not tracked. Block of deleted object is never returned. Block
+ * without owners is registered only while its linked object is acquired.
+ */
+template<typename Policy>
+inline auto find_block(const void *const p) noexcept -> control_block*
+{
+#ifdef OWNED_POINTER_REGISTRY
+  if(!block_registry::may_contain(p))
+    return nullptr;
+
+  auto& shard = block_registry::instance().shard_of(p);
+  std::lock_guard<std::mutex> guard{shard.lock};
+  const auto it = shard.blocks.find(p);
+
+  if(it == shard.blocks.end() || it->second->deleted<Policy>())
+    return nullptr;
+
+  if(!it->second->try_add_ref<Policy>())
+  {
+    if(!it->second->linked<Policy>() || !it->second->acquired<Policy>())
+      return nullptr;
+
+    it->second->add_ref_or_revive<Policy>();
+  }
+
+  return it->second;
+#else
+  return (void)p, nullptr;
+#endif
+}
+
+#ifdef OWNED_POINTER_TRACING
+/*
+ * Ring buffer of lifecycle events of single thread. Only owning thread writes
+ * to it, event is two relaxed stores and publication of head. Oldest events
+ * are overwritten, when buffer is full. Buffers are kept after their threads
+ * exit, so events can be written out at any time.
+ */
+constexpr std::size_t trace_capacity = OWNED_POINTER_TRACE_CAPACITY;
+static_assert((trace_capacity & (trace_capacity - 1)) == 0, "trace capacity must be power of two");
+
+inline auto trace_clock() noexcept -> std::uint64_t
+{
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+  return __builtin_ia32_rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct trace_record
+{
+  std::atomic<std::uint64_t> time;
+  std::atomic<std::uintptr_t> block_and_event; // block is aligned, so event fits in low bits
+};
+
+struct trace_buffer
+{
+  void push(const control_block *const cb, const lifecycle_event event) noexcept
+  {
+    const auto h = head.load(std::memory_order_relaxed);
+    auto& record = records[h & (trace_capacity - 1)];
+
+    record.time.store(trace_clock(), std::memory_order_relaxed);
+    record.block_and_event.store(reinterpret_cast<std::uintptr_t>(cb) | event, std::memory_order_relaxed);
+    head.store(h + 1, std::memory_order_release);
+  }
+
+  trace_record records[trace_capacity];
+  std::atomic<std::uint64_t> head;
+  unsigned thread;
+  trace_buffer* next;
+};
+
+struct trace_registry
+{
+  std::mutex lock;
+  trace_buffer* buffers;
+  unsigned threads;
+  std::uint64_t start_ticks;
+  std::chrono::steady_clock::time_point start_time;
+
+  static auto instance() noexcept -> trace_registry&
+  {
+    static trace_registry registry{{}, nullptr, 0, trace_clock(), std::chrono::steady_clock::now()};
+    return registry;
+  }
+
+  auto add() -> trace_buffer*
+  {
+    const auto buffer = new trace_buffer{};
+    std::lock_guard<std::mutex> guard{lock};
+
+    buffer->thread = ++threads;
+    buffer->next = buffers;
+    return buffers = buffer;
+  }
+};
+
+inline auto local_trace() -> trace_buffer&
+{
+  static thread_local trace_buffer *const buffer = trace_registry::instance().add();
+  return *buffer;
+}
+#endif
+
+/*
+ * Traces event of object tracked by control block. Compiles to nothing,
+ * unless OWNED_POINTER_TRACING is defined.
+ */
+inline void trace_event(const control_block *const cb, const lifecycle_event event) noexcept
+{
+#ifdef OWNED_POINTER_TRACING
+  local_trace().push(cb, event);
+#else
+  (void)cb, (void)event;
+#endif
+}
+
+/*
+ * Counts lifecycle event of object tracked by control block. Compiles to
+ * nothing, unless OWNED_POINTER_STATISTICS, OWNED_POINTER_SITE_REPORT or
+ * OWNED_POINTER_TRACING is defined.
+ */
+inline void count_event(const control_block *const cb, const lifecycle_event event) noexcept
+{
+#if defined(OWNED_POINTER_STATISTICS) || defined(OWNED_POINTER_SITE_REPORT) || defined(OWNED_POINTER_TRACING)
+  if(event == expired_event &&
+     !(cb->state.load(std::memory_order_acquire) & (control_block::acquired_flag | control_block::ever_acquired_flag)))
+    return; // deleted by owned_pointer, so already counted as never acquired
+#endif
+
+  trace_event(cb, event);
+
+#ifdef OWNED_POINTER_STATISTICS
+  auto& counter = cb->operations->statistics->local().events[event];
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#endif
+
+#ifdef OWNED_POINTER_SITE_REPORT
+  if(cb->site)
+    cb->site->events[event].fetch_add(1, std::memory_order_relaxed);
+#endif
+
+  (void)cb, (void)event;
+}
+
+/*
+ * Object given back to owned_pointer can be acquired again. Only its first
+ * acquisition is counted, the following ones are only traced.
+ */
+inline void count_acquired(control_block *const cb) noexcept
+{
+#if defined(OWNED_POINTER_STATISTICS) || defined(OWNED_POINTER_SITE_REPORT) || defined(OWNED_POINTER_TRACING)
+  if(cb->state.fetch_or(control_block::ever_acquired_flag, std::memory_order_acq_rel) & control_block::ever_acquired_flag)
+    return trace_event(cb, acquired_event);
+#endif
+
+  count_event(cb, acquired_event);
+}
+
+/*
+ * Object deleted by owned_pointer was never acquired, unless it was given back.
+ * Then its deletion is expiry, which linked object counts in its own dtor.
+ */
+inline void count_disposed(const control_block *const cb) noexcept
+{
+#if defined(OWNED_POINTER_STATISTICS) || defined(OWNED_POINTER_SITE_REPORT) || defined(OWNED_POINTER_TRACING)
+  const auto state = cb->state.load(std::memory_order_acquire);
+
+  if(!(state & control_block::ever_acquired_flag))
+    count_event(cb, never_acquired_event);
+  else if(!(state & control_block::linked_flag))
+    count_event(cb, expired_event);
+#else
+  (void)cb;
+#endif
+}
+
+/*
+ * Objects created without explicit site are reported together.
+ */
+inline auto unknown_site() noexcept -> allocation_site&
+{
+  static allocation_site site{"<unknown site>", 0};
+  return site;
+}
+
+/*
+ * Counts creation of object once. Site is set first, so with
+ * OWNED_POINTER_SITE_REPORT the same event is also counted by its site.
+ */
+inline void count_created(control_block *const cb, allocation_site& site) noexcept
+{
+#ifdef OWNED_POINTER_SITE_REPORT
+  cb->site = &site;
+#endif
+  (void)site;
+  count_event(cb, created_event);
+}
+
+#ifdef OWNED_POINTER_DELETE_HOOK
+/*
+ * Called by replaced operator delete before memory is freed. Most of deleted
+ * memory is not tracked, which costs single load of registry filter. Object
+ * found in registry is marked deleted, unless its tracking_deleter already did
+ * it, and forgotten, because its address can be reused.
+ */
+inline auto allocate_for_delete_hook(const std::size_t size) -> void*
+{
+  for(;;)
+  {
+    if(const auto p = std::malloc(size ? size : 1))
+      return p;
+
+    if(const auto handler = std::get_new_handler())
+      handler();
+    else
+      throw std::bad_alloc{};
+  }
+}
+
+inline void notify_operator_delete(void *const p) noexcept
+{
+  if(!block_registry::may_contain(p))
+    return;
+
+  auto& shard = block_registry::instance().shard_of(p);
+  std::lock_guard<std::mutex> guard{shard.lock};
+  const auto it = shard.blocks.find(p);
+
+  if(it != shard.blocks.end())
+  {
+    if(!it->second->deleted())
+    {
+      count_event(it->second, expired_event);
+      it->second->mark_deleted_by_owner();
+    }
+
+    shard.remove(it);
+  }
+}
+#endif
+
+/*
+ * owned_pointer made from std::unique_ptr holds just object until it is copied
+ * or observed, unless every object has to be known to statistics, site report,
+ * trace or registry.
+ */
+#if defined(OWNED_POINTER_STATISTICS) || defined(OWNED_POINTER_SITE_REPORT) || defined(OWNED_POINTER_TRACING) || \
+    defined(OWNED_POINTER_REGISTRY)
+constexpr bool lazy_blocks = false;
+#else
+constexpr bool lazy_blocks = true;
+#endif
+
+/*
+ * Blocks which track object alone all have the same size, so freed ones are
+ * cached per thread and reused, e.g. by block created each time mocked call
+ * copies its argument. Block freed by other thread than its creator moves to
+ * cache of that thread. Cache is plain data emptied by separate guard at exit
+ * of thread, blocks freed after that go straight to heap.
+ */
+#if OWNED_POINTER_BLOCK_POOL > 0
+struct block_cache
+{
+  void* blocks[OWNED_POINTER_BLOCK_POOL];
+  unsigned size;
+  bool closed;
+};
+
+inline auto local_block_cache() noexcept -> block_cache&
+{
+  static thread_local block_cache cache;
+  return cache;
+}
+
+struct block_cache_guard
+{
+  ~block_cache_guard()
+  {
+    auto& cache = local_block_cache();
+    cache.closed = true;
+
+    while(cache.size)
+      ::operator delete(cache.blocks[--cache.size]);
+  }
+};
+
+inline auto allocate_block() -> void*
+{
+  auto& cache = local_block_cache();
+  return cache.size ? cache.blocks[--cache.size] : ::operator new(sizeof(control_block));
+}
+
+inline void deallocate_block(void *const p) noexcept
+{
+  static thread_local block_cache_guard guard;
+  (void)guard;
+  auto& cache = local_block_cache();
+
+  if(!cache.closed && cache.size < OWNED_POINTER_BLOCK_POOL)
+    cache.blocks[cache.size++] = p;
+  else
+    ::operator delete(p);
+}
+#else
+inline auto allocate_block() -> void* { return ::operator new(sizeof(control_block)); }
+inline void deallocate_block(void *const p) noexcept { ::operator delete(p); }
+#endif
+
+inline auto new_block(void *const p, const block_operations& ops) -> control_block*
+{
+  return ::new(allocate_block()) control_block{p, ops, 1};
+}
+
+template<typename T>
+struct owned_deleter
+{
+  static void dispose(control_block *const cb) noexcept
+  {
+#ifdef OWNED_POINTER_ASSERT_DTOR
+    assert(cb->acquired() && "ASSERT: you created owned_pointer, but unique_ptr was never acquired");
+#else
+    if(!cb->acquired())
+    {
+      count_disposed(cb);
+      destroy(cb);
+    }
+#endif
+  }
+
+  static void destroy(control_block *const cb) noexcept
+  {
+    delete static_cast<T*>(cb->ptr);
+  }
+
+  static void deallocate(control_block *const cb) noexcept
+  {
+    cb->~control_block();
+    deallocate_block(cb);
+  }
+
+  static const block_operations operations;
+};
+
+template<typename T>
+const block_operations owned_deleter<T>::operations = operations_of<T, owned_deleter<T>>();
+
+/*
+ * Object without virtual dtor, which lives in memory of its block, is only
+ * destroyed and its memory is given back together with the block.
+ */
+template<typename T>
+struct in_place_deleter
+{
+  static void dispose(control_block *const cb) noexcept
+  {
+#ifdef OWNED_POINTER_ASSERT_DTOR
+    assert(cb->acquired() && "ASSERT: you created owned_pointer, but unique_ptr was never acquired");
+#else
+    if(!cb->acquired())
+    {
+      count_disposed(cb);
+      destroy(cb);
+    }
+#endif
+  }
+
+  static void destroy(control_block *const cb) noexcept
+  {
+    static_cast<T*>(cb->ptr)->~T();
+    cb->release_weak();
+  }
+};
+
+/*
+ * Link between object and control block, which tracks it. Block stays in
+ * memory as long as link exists, so notification about deletion needs no
+ * lock of reference counter. Object created by make_owned is stored inline
+ * with its block and that storage already keeps block alive.
+ */
+class shared_secret
+{
+public:
+  shared_secret() = default;
+  shared_secret(const shared_secret&) = delete;
+  shared_secret& operator=(const shared_secret&) = delete;
+
+  virtual ~shared_secret()
+  {
+    unlink();
+  }
+
+  /*
+   * Object is held by caller, so block it is linked to is shared again, also
+   * when its last owned_pointer is already gone, and observers keep watching it.
+   */
+  auto lock() noexcept -> _priv::control_block*
+  {
+    if(control_block)
+      control_block->add_ref_or_revive();
+
+    return control_block;
+  }
+
+  void link(_priv::control_block *const cb) noexcept
+  {
+    cb->add_weak();
+    cb->mark_linked();
+
+    unlink();
+    control_block = cb;
+    counted = true;
+  }
+
+  void link_inline(_priv::control_block *const cb) noexcept
+  {
+    cb->mark_linked();
+    control_block = cb;
+  }
+
+protected:
+  void delete_event() noexcept
+  {
+    if(control_block)
+    {
+      _priv::count_event(control_block, _priv::expired_event);
+      control_block->mark_deleted_by_owner();
+      _priv::unregister_block(control_block);
+    }
+  }
+
+private:
+  void unlink() noexcept
+  {
+    if(counted)
+      control_block->release_weak();
+  }
+
+  _priv::control_block* control_block{nullptr};
+  bool counted{false};
+};
+
+template<typename Base>
+struct destruction_notify_object : Base, shared_secret
+{
+   using Base::Base;
+   ~destruction_notify_object() override { delete_event(); }
+
+   static void operator delete(void *const p) noexcept
+   {
+     auto cb = reinterpret_cast<_priv::control_block*>(p) - 1;
+     cb->release_weak();
+   }
+};
+
+/*
+ * Memory layout of single allocation: [allocator | control_block | object].
+ * Control block always directly precedes object, so object can find it without
+ * any knowledge about allocator, which was used.
+ */
+template<typename Object, typename Alloc, typename Deleter = owned_deleter<Object>>
+struct fused_layout
+{
+  using unit_type = typename std::aligned_storage<sizeof(std::max_align_t), alignof(std::max_align_t)>::type;
+  using unit_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<unit_type>;
+  using unit_traits = std::allocator_traits<unit_allocator>;
+
+  struct prefix
+  {
+    unit_allocator alloc;
+    unit_type* raw;
+  };
+
+  static_assert(std::is_same<typename unit_traits::pointer, unit_type*>::value,
+                "allocate_owned supports only allocators with raw pointers");
+  static_assert(sizeof(control_block) % alignof(prefix) == 0,
+                "allocator is over-aligned");
+
+  static constexpr std::size_t align = alignof(Object) > alignof(prefix) ?
+                                       alignof(Object) : alignof(prefix);
+  static constexpr std::size_t slack = align > alignof(unit_type) ? align : 0;
+  static constexpr std::size_t units = (sizeof(prefix) + sizeof(control_block) + sizeof(Object) + slack +
+                                        sizeof(unit_type) - 1) / sizeof(unit_type);
+
+  static auto object_address(unit_type *const raw) noexcept -> Object*
+  {
+    const auto address = reinterpret_cast<std::uintptr_t>(raw) + sizeof(prefix) + sizeof(control_block);
+    return reinterpret_cast<Object*>((address + align - 1) / align * align);
+  }
+
+  static auto prefix_of(control_block *const cb) noexcept -> prefix*
+  {
+    return reinterpret_cast<prefix*>(cb) - 1;
+  }
+
+  static void dispose(control_block *const cb) noexcept
+  {
+    Deleter::dispose(cb);
+  }
+
+  static void destroy(control_block *const cb) noexcept
+  {
+    Deleter::destroy(cb);
+  }
+
+  static void deallocate(control_block *const cb) noexcept
+  {
+    const auto p = prefix_of(cb);
+    const auto raw = p->raw;
+    unit_allocator alloc{std::move(p->alloc)};
+
+    p->~prefix();
+    cb->~control_block();
+    unit_traits::deallocate(alloc, raw, units);
+  }
+
+  static const block_operations operations;
+};
+
+template<typename Object, typename Alloc, typename Deleter>
+const block_operations fused_layout<Object, Alloc, Deleter>::operations =
+    operations_of<Object, fused_layout<Object, Alloc, Deleter>>();
+
+/*
+ * Returned control block is already referenced once. Weak counter is held by
+ * owned_pointers and by memory of object.
+ */
+template<typename Object, typename Stored, typename Deleter, typename Alloc, typename... Args>
+auto construct_fused(const Alloc& a, Args&&... args) -> control_block*
+{
+  using layout = fused_layout<Stored, Alloc, Deleter>;
+
+  typename layout::unit_allocator alloc{a};
+  const auto raw = layout::unit_traits::allocate(alloc, layout::units);
+  const auto object = layout::object_address(raw);
+  const auto cb = ::new(reinterpret_cast<control_block*>(object) - 1) control_block{nullptr, layout::operations, 2};
+  ::new(layout::prefix_of(cb)) typename layout::prefix{alloc, raw};
+
+  try
+  {
+    cb->ptr = static_cast<Object*>(::new(object) Stored{ std::forward<Args>(args)... });
+  }
+  catch(...)
+  {
+    layout::deallocate(cb);
+    throw;
+  }
+
+  return cb;
+}
+
+/* Memory of object also serves as its link */
+template<typename Object, typename Alloc, typename... Args>
+auto make_fused(allocation_site& site, const Alloc& a, Args&&... args) -> control_block*
+{
+  using notify_type = destruction_notify_object<Object>;
+
+  const auto cb = construct_fused<Object, notify_type, owned_deleter<notify_type>>(a, std::forward<Args>(args)...);
+  count_created(cb, site);
+  register_block(cb);
+
+  return static_cast<notify_type*>(static_cast<Object*>(cb->ptr))->link_inline(cb), cb;
+}
+
+/* Object without virtual dtor can not notify its deletion, so only tracking_deleter may free it */
+template<typename Object, typename Alloc, typename... Args>
+auto make_in_place(allocation_site& site, const Alloc& a, Args&&... args) -> control_block*
+{
+  const auto cb = construct_fused<Object, Object, in_place_deleter<Object>>(a, std::forward<Args>(args)...);
+  cb->state.store(control_block::in_place_flag, std::memory_order_relaxed);
+  count_created(cb, site);
+  register_block(cb);
+
+  return cb;
+}
+
+/*
+ * Single allocation for batch of objects created by make_owned_n. Every slot
+ * is laid out as [arena | control_block | object], so object finds its block
+ * as usual and block finds arena, which is freed together with its last slot.
+ * When objects can not be deleted from inside of arena, slot has no object.
+ */
+struct arena_header
+{
+  void release(const std::size_t slots = 1) noexcept
+  {
+    if(users.fetch_sub(slots, std::memory_order_acq_rel) == slots)
+    {
+      this->~arena_header();
+      ::operator delete(this);
+    }
+  }
+
+  std::atomic<std::size_t> users;
+};
+
+template<typename Stored>
+struct slot_payload : std::integral_constant<std::size_t, sizeof(Stored)>
+{
+  static constexpr std::size_t align = alignof(Stored);
+};
+
+template<>
+struct slot_payload<void> : std::integral_constant<std::size_t, 0>
+{
+  static constexpr std::size_t align = 1;
+};
+
+template<typename Object, typename Stored>
+struct arena_layout
+{
+  static constexpr std::size_t align = slot_payload<Stored>::align > alignof(control_block) ?
+                                       slot_payload<Stored>::align : alignof(control_block);
+  static constexpr std::size_t header = (sizeof(arena_header) + align - 1) / align * align;
+  static constexpr std::size_t offset = (sizeof(arena_header*) + sizeof(control_block) + align - 1) / align * align;
+  static constexpr std::size_t stride = (offset + slot_payload<Stored>::value + align - 1) / align * align;
+
+  static auto allocate(const std::size_t n) -> arena_header*
+  {
+    const auto arena = ::new(::operator new(header + n * stride)) arena_header{};
+    return arena->users.store(n + 1, std::memory_order_relaxed), arena;
+  }
+
+  static auto slot(arena_header *const arena, const std::size_t i) noexcept -> control_block*
+  {
+    const auto object = reinterpret_cast<unsigned char*>(arena) + header + i * stride + offset;
+    return reinterpret_cast<control_block*>(object) - 1;
+  }
+
+  static auto arena_of(control_block *const cb) noexcept -> arena_header*&
+  {
+    return *(reinterpret_cast<arena_header**>(cb) - 1);
+  }
+
+  static void dispose(control_block *const cb) noexcept
+  {
+    owned_deleter<Object>::dispose(cb);
+  }
+
+  static void destroy(control_block *const cb) noexcept
+  {
+    owned_deleter<Object>::destroy(cb);
+  }
+
+  static void deallocate(control_block *const cb) noexcept
+  {
+    const auto arena = arena_of(cb);
+
+    cb->~control_block();
+    arena->release();
+  }
+
+  static const block_operations operations;
+};
+
+template<typename Object, typename Stored>
+const block_operations arena_layout<Object, Stored>::operations = operations_of<Object, arena_layout<Object, Stored>>();
+
+template<typename T>
+class link_ptr
+{
+public:
+  template<typename R>
+  explicit link_ptr(const std::unique_ptr<R>& u) noexcept : ptr{u.get()} {}
+
+  link_ptr(const link_ptr&) = delete;
+  link_ptr(link_ptr&&) noexcept = default;
+  link_ptr& operator=(link_ptr&&) = delete;
+  link_ptr& operator=(const link_ptr&) = delete;
+
+  auto get() const noexcept -> T* { return ptr; }
+
+private:
+  T* const ptr;
+};
+
+template<typename T>
+struct is_expired_enabled :
+  std::integral_constant<bool, std::has_virtual_destructor<T>::value
+                                #if __cplusplus >= 201402L
+                                  && !std::is_final<T>::value
+                                #endif
+                        > {};
+
+template<typename Policy, typename = void>
+struct access_of : std::integral_constant<access_check, access_check::checked> {};
+
+template<typename Policy>
+struct access_of<Policy, decltype(void(Policy::access))> : std::integral_constant<access_check, Policy::access> {};
+
+#ifdef NDEBUG
+constexpr bool debug_build = false;
+#else
+constexpr bool debug_build = true;
+#endif
+
+/* Deleted flag is read for every type, tracked_unique_ptr can set it also without virtual dtor */
+template<typename Policy>
+struct is_access_checked :
+  std::integral_constant<bool, access_of<Policy>::value == access_check::checked ||
+                               (access_of<Policy>::value == access_check::debug_checked && debug_build)> {};
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define OWNED_POINTER_COLD __attribute__((noinline, cold))
+#elif defined(_MSC_VER)
+#  define OWNED_POINTER_COLD __declspec(noinline)
+#else
+#  define OWNED_POINTER_COLD
+#endif
+
+/*
+ * Kept out of line, so check of expiry stays small enough to be inlined.
+ * Template is used instead of inline function, which can not be noinline.
+ */
+template<typename = void>
+[[noreturn]] OWNED_POINTER_COLD void throw_ptr_is_already_deleted();
+
+/*
+ * Gives library internals access to control block of owned_pointer, so objects
+ * created by library are passed to owned_pointer without any runtime lookup.
+ */
+struct access
+{
+  template<typename Pointer>
+  static auto adopt(control_block *const cb) noexcept -> Pointer
+  {
+    return Pointer{cb};
+  }
+
+  /*
+   * Creates control block of pointer, which holds just object.
+   */
+  template<typename Pointer>
+  static auto control_block_of(const Pointer& p) -> control_block*
+  {
+    return p.block();
+  }
+
+  template<typename Pointer>
+  static auto existing_block_of(const Pointer& p) noexcept -> control_block*
+  {
+    return p.existing_block();
+  }
+};
+
+} // namespace _priv
+
+/*
+ * Deleter of object acquired by owned_pointer::tracked_unique_ptr. It holds
+ * weak reference of control block and marks object deleted before freeing
+ * it, so expiry is known also for classes without virtual dtor.
+ */
+class tracking_deleter
+{
+  template<typename, typename>
+  friend class owned_pointer;
+
+public:
+  constexpr tracking_deleter() noexcept = default;
+  tracking_deleter(tracking_deleter&& other) noexcept;
+  auto operator=(tracking_deleter&& other) noexcept -> tracking_deleter&;
+  ~tracking_deleter();
+
+  template<typename T>
+  void operator()(T *const p) noexcept;
+
+private:
+  explicit tracking_deleter(_priv::control_block *const cb) noexcept : control_block{cb} {}
+
+  auto release() noexcept -> _priv::control_block*;
+
+  _priv::control_block* control_block{nullptr};
+};
+
+template<typename T>
+using tracked_unique_ptr = std::unique_ptr<T, tracking_deleter>;
+
+template<typename Tp, typename Policy = thread_safe>
+class owned_pointer
+{
+  static_assert(!std::is_array<Tp>::value && !std::is_pointer<Tp>::value, "no array nor pointer supported");
+
+#ifdef OWNED_POINTER_STRICT_SAFETY
+  static_assert(
+      _priv::is_expired_enabled<Tp>::value,
+      "This type is not strictly safe to use with owned_pointer");
+#endif
+
+  template<typename, typename>
+  friend class owned_pointer;
+
+  friend struct _priv::access;
+
+public:
+  using element_type = Tp;
+  using policy_type = Policy;
+  using uptr_type = std::unique_ptr<element_type>;
+  using tracked_uptr_type = csp::tracked_unique_ptr<element_type>;
+
+  constexpr owned_pointer() noexcept = default;
+  constexpr owned_pointer(std::nullptr_t) noexcept {}
+
+  owned_pointer(const owned_pointer& other);
+  owned_pointer(owned_pointer&& other) noexcept;
+  owned_pointer& operator=(owned_pointer other) noexcept;
+  ~owned_pointer();
+
+  template<typename T>
+  owned_pointer(_priv::link_ptr<T>&& p) : owned_pointer(p.get(), true) {}
+
+  template<typename T>
+  owned_pointer(std::unique_ptr<T>&& p) : owned_pointer(p.release(), false) {}
+
+  template<typename T>
+  owned_pointer(std::unique_ptr<T, tracking_deleter>&& p);
+
+  auto get() const -> element_type*;
+  explicit operator uptr_type() const;
+  auto unique_ptr() const -> uptr_type;
+  auto tracked_unique_ptr() const -> tracked_uptr_type;
+  auto expired() const noexcept -> bool;
+  auto raw_ptr() const -> element_type*;
+  auto acquired() const noexcept -> bool;
+  explicit operator bool() const noexcept;
+  auto operator*() const -> element_type&;
+  auto operator->() const -> element_type*;
+  auto get(std::nothrow_t) const noexcept -> element_type*;
+  auto use_count() const noexcept -> long;
+  void swap(owned_pointer& other) noexcept;
+
+  template<typename X = element_type>
+  auto begin() const -> decltype(std::declval<X>().begin()) { return get()->begin(); }
+  
+  template<typename X = element_type>
+  auto end() const -> decltype(std::declval<X>().end()) { return get()->end(); }
+  
+  template<typename X = element_type>
+  auto cbegin() const -> decltype(std::declval<X>().cbegin()) { return get()->cbegin(); }
+  
+  template<typename X = element_type>
+  auto cend() const -> decltype(std::declval<X>().cend()) { return get()->end(); }
+
+  template<typename X = element_type>
+  auto size() const -> decltype(std::declval<X>().size()) { return get()->size(); }
+  
+  template<typename T, typename P>
+  operator owned_pointer<T, P>() const;
+
+  template<typename T>
+  auto compare(const T& ptr) const noexcept -> std::int8_t;
+
+  template<typename T, typename P>
+  auto compare(const owned_pointer<T, P>& p) const noexcept -> std::int8_t;
+
+private:
+  /*
+   * Handle is either control block or object tagged in lowest bits, when it
+   * was moved in from std::unique_ptr and nothing needed its block yet.
+   */
+  static constexpr std::uintptr_t lazy_tag = 1;
+  static constexpr std::uintptr_t lazy_acquired = 2;
+
+  owned_pointer(element_type *const p, const bool acquired);
+  explicit owned_pointer(_priv::control_block *const cb) noexcept : handle{reinterpret_cast<std::uintptr_t>(cb)} {}
+
+  static constexpr auto lazy_enabled() noexcept -> bool
+  {
+    return _priv::lazy_blocks && alignof(element_type) > (lazy_tag | lazy_acquired);
+  }
+
+  static constexpr auto is_lazy(const std::uintptr_t h) noexcept -> bool
+  {
+    return lazy_enabled() && (h & lazy_tag);
+  }
+
+  static auto block_in(const std::uintptr_t h) noexcept -> _priv::control_block*
+  {
+    return is_lazy(h) ? nullptr : reinterpret_cast<_priv::control_block*>(h);
+  }
+
+  static auto object_in(const std::uintptr_t h) noexcept -> element_type*
+  {
+    return reinterpret_cast<element_type*>(h & ~(lazy_tag | lazy_acquired));
+  }
+
+  auto load_handle() const noexcept -> std::uintptr_t
+  {
+    return policy_type::load(handle, std::memory_order_acquire);
+  }
+
+  auto existing_block() const noexcept -> _priv::control_block*
+  {
+    return block_in(load_handle());
+  }
+
+  auto block() const -> _priv::control_block*
+  {
+    const auto h = load_handle();
+    return is_lazy(h) ? materialize(h) : block_in(h);
+  }
+
+  auto materialize(std::uintptr_t h) const -> _priv::control_block*;
+  auto stored_address() const noexcept -> element_type*;
+  auto acquire(unsigned char refused = _priv::control_block::refused_by_unique) const -> element_type*;
+  static void throw_when_ptr_expired(const _priv::control_block* cb);
+
+#if OWNED_POINTER_RTTI
+  template<typename T, typename = typename std::enable_if<_priv::is_expired_enabled<T>::value, void>::type>
+  static auto get_secret_when_possible(T *const p) noexcept -> _priv::shared_secret*
+  {
+    return dynamic_cast<_priv::shared_secret*>(p);
+  }
+
+#endif
+
+  static auto get_secret_when_possible(...) noexcept -> _priv::shared_secret*
+  {
+    return nullptr;
+  }
+
+  mutable std::atomic<std::uintptr_t> handle{0};
+};
+
+template<typename P>
+struct owned_pointer<void, P>
+{};
+
+/*
+ * Batch of owned_pointers created by make_owned_n. Objects and their control
+ * blocks are placed in one arena, so iteration over them is cache friendly.
+ */
+template<typename T, typename Policy = thread_safe>
+class owned_range
+{
+public:
+  using value_type = owned_pointer<T, Policy>;
+  using container_type = std::vector<value_type>;
+  using iterator = typename container_type::iterator;
+  using const_iterator = typename container_type::const_iterator;
+  using uptr_type = typename value_type::uptr_type;
+
+  owned_range() = default;
+  explicit owned_range(container_type p) noexcept : pointers(std::move(p)) {}
+
+  auto begin() noexcept -> iterator { return pointers.begin(); }
+  auto end() noexcept -> iterator { return pointers.end(); }
+  auto begin() const noexcept -> const_iterator { return pointers.begin(); }
+  auto end() const noexcept -> const_iterator { return pointers.end(); }
+
+  auto size() const noexcept -> std::size_t { return pointers.size(); }
+  auto empty() const noexcept -> bool { return pointers.empty(); }
+
+  auto operator[](const std::size_t i) noexcept -> value_type& { return pointers[i]; }
+  auto operator[](const std::size_t i) const noexcept -> const value_type& { return pointers[i]; }
+
+  auto erase(const_iterator first, const_iterator last) -> iterator { return pointers.erase(first, last); }
+
+  auto acquire_all() const -> std::vector<uptr_type>;
+
+private:
+  container_type pointers;
+};
+
+/*
+ * Non-owning handle of object tracked by owned_pointer. Observer holds only
+ * weak reference of control block, so it neither keeps object alive nor
+ * takes part in its ownership. Checking expiry only loads state, and also
+ * reference counter of object not acquired yet. Weak reference keeps state
+ * valid, so copy of observer increments weak counter, atomically with
+ * thread_safe policy. Observer can be promoted back to owned_pointer, while
+ * any owned_pointer of object exists.
+ */
+template<typename Tp, typename Policy = thread_safe>
+class owned_observer
+{
+  template<typename, typename>
+  friend class owned_observer;
+
+public:
+  using element_type = Tp;
+  using policy_type = Policy;
+
+  constexpr owned_observer() noexcept = default;
+  constexpr owned_observer(std::nullptr_t) noexcept {}
+
+  template<typename T, typename P>
+  owned_observer(const owned_pointer<T, P>& p);
+
+  template<typename T, typename P>
+  owned_observer(const owned_observer<T, P>& other) noexcept;
+
+  owned_observer(const owned_observer& other) noexcept;
+  owned_observer(owned_observer&& other) noexcept;
+  auto operator=(owned_observer other) noexcept -> owned_observer&;
+  ~owned_observer();
+
+  auto expired() const noexcept -> bool;
+  auto acquired() const noexcept -> bool;
+  auto use_count() const noexcept -> long;
+  auto lock() const noexcept -> owned_pointer<element_type, policy_type>;
+
+  void swap(owned_observer& other) noexcept;
+  explicit operator bool() const noexcept { return control_block != nullptr; }
+
+private:
+  static auto observe(_priv::control_block *const cb) noexcept -> _priv::control_block*
+  {
+    return cb ? cb->add_weak<policy_type>(), cb : nullptr;
+  }
+
+  _priv::control_block* control_block{nullptr};
+};
+
+#if __cplusplus >= 201703L
+template<typename T>
+owned_pointer(std::unique_ptr<T>&&) -> owned_pointer<T>;
+
+template<typename T>
+owned_pointer(_priv::link_ptr<T>&&) -> owned_pointer<T>;
+#endif
+
+/*****************************************************************************************
+ *
+ * Public Exceptions
+ *
+ *****************************************************************************************/
+
+struct unique_ptr_already_acquired : public std::runtime_error
+{
+  unique_ptr_already_acquired() : std::runtime_error("owned_pointer: This pointer is already acquired by unique_ptr") {}
+};
+
+struct ptr_is_already_deleted : public std::runtime_error
+{
+  ptr_is_already_deleted() : std::runtime_error("owned_pointer: This pointer is already deleted") {}
+};
+
+struct unique_ptr_can_not_free_object : public std::runtime_error
+{
+  unique_ptr_can_not_free_object()
+    : std::runtime_error("owned_pointer: This object can be freed only by tracked_unique_ptr") {}
+};
+
+template<typename>
+void _priv::throw_ptr_is_already_deleted()
+{
+  throw ptr_is_already_deleted();
+}
+
+/*****************************************************************************************
+ *
+ * Public member class functions
+ *
+ *****************************************************************************************/
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::get() const -> element_type*
+{
+  const auto h = load_handle();
+
+  if(is_lazy(h))
+    return object_in(h);
+
+  _priv::control_block *const cb = block_in(h);
+
+  if(!cb)
+    return nullptr;
+
+  throw_when_ptr_expired(cb);
+  return static_cast<element_type*>(cb->ptr);
+}
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::operator->() const -> element_type*
+{
+  return get();
+}
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::operator*() const -> element_type&
+{
+  return *get();
+}
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::unique_ptr() const -> uptr_type
+{
+  return uptr_type{acquire()};
+}
+
+/*
+ * Acquires object like unique_ptr(), but its deleter tells control block
+ * about deletion. It costs one more pointer and weak reference of block.
+ */
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::tracked_unique_ptr() const -> tracked_uptr_type
+{
+  _priv::control_block *const cb = block();
+  const auto p = acquire(_priv::control_block::refused_by_tracked);
+
+  if(p)
+    cb->add_weak<policy_type>();
+
+  return tracked_uptr_type{p, tracking_deleter{p ? cb : nullptr}};
+}
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::raw_ptr() const -> element_type*
+{
+  return unique_ptr().release();
+}
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::acquired() const noexcept -> bool
+{
+  const auto h = load_handle();
+
+  if(is_lazy(h))
+    return h & lazy_acquired;
+
+  return h && block_in(h)->template acquired<policy_type>();
+}
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::expired() const noexcept -> bool
+{
+  _priv::control_block *const cb = existing_block();
+  return cb && cb->deleted<policy_type>();
+}
+
+template<typename T, typename P>
+inline owned_pointer<T, P>::operator uptr_type() const
+{
+  return unique_ptr();
+}
+
+template<typename T, typename P>
+inline owned_pointer<T, P>::operator bool() const noexcept
+{
+  return stored_address();
+}
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::get(std::nothrow_t) const noexcept -> element_type*
+{
+  return expired() ? nullptr : stored_address();
+}
+
+template<typename T, typename P>
+inline owned_pointer<T, P>::owned_pointer(const owned_pointer& other) : owned_pointer{other.block()}
+{
+  if(_priv::control_block *const cb = block_in(handle.load(std::memory_order_relaxed)))
+  {
+    cb->add_ref<policy_type>();
+    _priv::trace_event(cb, _priv::copied_event);
+  }
+}
+
+template<typename T, typename P>
+inline owned_pointer<T, P>::owned_pointer(owned_pointer&& other) noexcept
+  : handle{other.handle.load(std::memory_order_relaxed)}
+{
+  other.handle.store(0, std::memory_order_relaxed);
+}
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::operator=(owned_pointer other) noexcept -> owned_pointer&
+{
+  return swap(other), *this;
+}
+
+/*
+ * Object held without control block was never seen by anyone else, so it is
+ * deleted here just like by owned_deleter.
+ */
+template<typename T, typename P>
+inline owned_pointer<T, P>::~owned_pointer()
+{
+  const auto h = handle.load(std::memory_order_relaxed);
+
+  if(is_lazy(h))
+  {
+#ifdef OWNED_POINTER_ASSERT_DTOR
+    assert((h & lazy_acquired) && "ASSERT: you created owned_pointer, but unique_ptr was never acquired");
+#else
+    if(!(h & lazy_acquired))
+      delete object_in(h);
+#endif
+  }
+  else if(h)
+    block_in(h)->template release<policy_type>();
+}
+
+template<typename T, typename P>
+inline auto owned_pointer<T, P>::use_count() const noexcept -> long
+{
+  const auto h = load_handle();
+
+  if(is_lazy(h))
+    return 1;
+
+  return h ? block_in(h)->refs.load(std::memory_order_relaxed) : 0;
+}
+
+template<typename T, typename P>
+inline void owned_pointer<T, P>::swap(owned_pointer& other) noexcept
+{
+  const auto h = handle.load(std::memory_order_relaxed);
+  handle.store(other.handle.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  other.handle.store(h, std::memory_order_relaxed);
+}
+
+template<typename R, typename Q> template<typename T, typename P>
+inline owned_pointer<R, Q>::operator owned_pointer<T, P>() const
+{
+  static_assert(std::is_convertible<element_type*, T*>::value,
+                "Casting to pointer of different or non-derived type");
+
+  _priv::control_block *const cb = block();
+
+  if(cb)
+  {
+    cb->add_ref<policy_type>();
+    _priv::trace_event(cb, _priv::copied_event);
+  }
+
+  return owned_pointer<T, P>{cb};
+}
+
+template<typename R, typename Q> template<typename T>
+inline auto owned_pointer<R, Q>::compare(const T& ptr) const noexcept -> std::int8_t
+{
+  static_assert(std::is_convertible<T, element_type*>::value ||
+                std::is_convertible<element_type*, T>::value,
+                "Comparing pointer of different or non-derived type");
+
+  using common_ptr = typename std::common_type<element_type*, T>::type;
+
+  const common_ptr addr{stored_address()}, other{ptr};
+  return addr == other ? 0 : (std::less<common_ptr>()(addr, other) ? -1 : +1);
+}
+
+template<typename R, typename Q> template<typename T, typename P>
+inline auto owned_pointer<R, Q>::compare(const owned_pointer<T, P>& p) const noexcept -> std::int8_t
+{
+  return compare(p.stored_address());
+}
+/*****************************************************************************************
+ *
+ * Private member class functions
+ *
+ *****************************************************************************************/
+
+/*
+ * Copies race for creation of block of single handle, so block is published
+ * by compare exchange and loser frees its own one. Block starts with reference
+ * of this handle.
+ */
+template<typename T, typename P>
+OWNED_POINTER_COLD auto owned_pointer<T, P>::materialize(std::uintptr_t h) const -> _priv::control_block*
+{
+  const auto cb = _priv::new_block(object_in(h), _priv::owned_deleter<element_type>::operations);
+
+  do
+  {
+    cb->state.store((h & lazy_acquired) ? _priv::control_block::acquired_flag : 0, std::memory_order_relaxed);
+
+    if(policy_type::compare_exchange(handle, h, reinterpret_cast<std::uintptr_t>(cb), std::memory_order_acq_rel))
+      return cb;
+  }
+  while(is_lazy(h));
+
+  _priv::owned_deleter<element_type>::deallocate(cb);
+  return block_in(h);
+}
+
+template<typename T, typename P>
+auto owned_pointer<T, P>::stored_address() const noexcept -> element_type*
+{
+  const auto h = load_handle();
+
+  if(is_lazy(h))
+    return object_in(h);
+
+  return h ? static_cast<element_type*>(block_in(h)->ptr) : nullptr;
+}
+
+/*
+ * Object held without block is acquired by single compare exchange, so no
+ * block is ever created for handle, which is just passed through.
+ */
+template<typename T, typename P>
+auto owned_pointer<T, P>::acquire(const unsigned char refused) const -> element_type*
+{
+  auto h = load_handle();
+
+  while(is_lazy(h))
+  {
+    if(h & lazy_acquired)
+      throw unique_ptr_already_acquired();
+
+    if(policy_type::compare_exchange(handle, h, h | lazy_acquired, std::memory_order_acq_rel))
+      return object_in(h);
+  }
+
+  _priv::control_block *const cb = block_in(h);
+
+  if(!cb)
+    return nullptr;
+
+  const auto state = cb->try_acquire<policy_type>(refused);
+
+  if(state & _priv::control_block::deleted_flag)
+    throw ptr_is_already_deleted();
+
+  if(state & _priv::control_block::acquired_flag)
+    throw unique_ptr_already_acquired();
+
+  if(state & refused)
+    throw unique_ptr_can_not_free_object();
+
+  _priv::count_acquired(cb);
+  return static_cast<element_type*>(cb->ptr);
+}
+
+template<typename T, typename P>
+inline void owned_pointer<T, P>::throw_when_ptr_expired(const _priv::control_block *const cb)
+{
+  if(_priv::is_access_checked<policy_type>::value && cb->deleted<policy_type>())
+    _priv::throw_ptr_is_already_deleted<>();
+}
+
+template<typename T, typename P>
+owned_pointer<T, P>::owned_pointer(element_type *const p, const bool acquired)
+{
+  if(!p) return;
+  const auto ss = get_secret_when_possible(p);
+  _priv::control_block* cb = ss ? ss->lock() : _priv::find_block<policy_type>(p);
+
+  if(!cb && !ss && lazy_enabled())
+  {
+    handle.store(reinterpret_cast<std::uintptr_t>(p) | lazy_tag | (acquired ? lazy_acquired : 0), std::memory_order_relaxed);
+    return;
+  }
+
+  if(!cb)
+  {
+    cb = _priv::new_block(p, _priv::owned_deleter<element_type>::operations);
+    _priv::count_created(cb, _priv::unknown_site());
+    _priv::register_block(cb);
+
+    if(ss)
+      ss->link(cb);
+  }
+
+  if(acquired)
+    _priv::count_acquired(cb);
+
+  cb->set_acquired<policy_type>(acquired);
+  handle.store(reinterpret_cast<std::uintptr_t>(cb), std::memory_order_relaxed);
+}
+
+/*
+ * Object returns to control block, which tracked it, also when its last
+ * owned_pointer is already gone, because deleter still keeps that block.
+ */
+template<typename R, typename Q> template<typename T>
+owned_pointer<R, Q>::owned_pointer(std::unique_ptr<T, tracking_deleter>&& p)
+{
+  _priv::control_block *const cb = p.get_deleter().release();
+  const auto object = p.release();
+
+  if(cb)
+  {
+    cb->add_ref_or_revive<policy_type>();
+    cb->set_acquired<policy_type>(false);
+    handle.store(reinterpret_cast<std::uintptr_t>(cb), std::memory_order_relaxed);
+    cb->release_weak();
+  }
+  else
+    *this = owned_pointer{object, false};
+}
+
+inline tracking_deleter::tracking_deleter(tracking_deleter&& other) noexcept : control_block{other.release()}
+{}
+
+inline auto tracking_deleter::operator=(tracking_deleter&& other) noexcept -> tracking_deleter&
+{
+  return std::swap(control_block, other.control_block), *this;
+}
+
+inline tracking_deleter::~tracking_deleter()
+{
+  if(control_block)
+    control_block->release_weak();
+}
+
+/*
+ * Object with shared_secret notifies its block on its own. Block is released
+ * after deletion, so the same deleter can not flag it again.
+ */
+template<typename T>
+inline void tracking_deleter::operator()(T *const p) noexcept
+{
+  if(const auto cb = release())
+  {
+    if(!cb->linked())
+    {
+      _priv::count_event(cb, _priv::expired_event);
+      cb->mark_deleted_by_owner();
+    }
+
+    if(cb->state.load(std::memory_order_relaxed) & _priv::control_block::in_place_flag)
+      cb->operations->destroy(cb);
+    else
+      delete p;
+
+    cb->release_weak();
+  }
+  else
+    delete p;
+}
+
+inline auto tracking_deleter::release() noexcept -> _priv::control_block*
+{
+  const auto cb = control_block;
+  return control_block = nullptr, cb;
+}
+
+/*****************************************************************************************
+ *
+ * Public non-member functions
+ *
+ *****************************************************************************************/
+
+template<typename T>
+struct is_expired_enabled {};
+
+template<typename T, typename P>
+struct is_expired_enabled<owned_pointer<T, P>> : _priv::is_expired_enabled<T> {};
+
+template<typename T, typename P>
+struct is_expired_enabled<owned_pointer<T, P>&> : _priv::is_expired_enabled<T> {};
+
+template<typename T, typename P>
+struct is_expired_enabled<owned_pointer<T, P>&&> : _priv::is_expired_enabled<T> {};
+
+template<typename T, typename P>
+struct is_expired_enabled<const owned_pointer<T, P>> : _priv::is_expired_enabled<T> {};
+
+template<typename T, typename P>
+struct is_expired_enabled<const owned_pointer<T, P>&> : _priv::is_expired_enabled<T> {};
+
+template<typename T, typename P>
+struct is_expired_enabled<const owned_pointer<T, P>&&> : _priv::is_expired_enabled<T> {};
+
+#if __cplusplus >= 201402L
+template<typename T>
+constexpr bool is_expired_enabled_v{is_expired_enabled<T>::value};
+#endif
+
+template<typename T, typename P, typename = typename std::enable_if<_priv::is_expired_enabled<T>::value, void>::type>
+inline bool is_expired_enabled_f(const owned_pointer<T, P>& p) noexcept
+{
+  const auto cb = _priv::access::existing_block_of(p);
+  return cb && cb->linked();
+}
+
+template<typename T>
+inline bool is_expired_enabled_f(const T&) noexcept
+{
+  return false;
+}
+
+template<typename R, typename Q> template<typename T, typename P>
+inline owned_observer<R, Q>::owned_observer(const owned_pointer<T, P>& p)
+  : control_block{observe(_priv::access::control_block_of(p))}
+{
+  static_assert(std::is_convertible<T*, element_type*>::value,
+                "Observing pointer of different or non-derived type");
+}
+
+template<typename R, typename Q> template<typename T, typename P>
+inline owned_observer<R, Q>::owned_observer(const owned_observer<T, P>& other) noexcept
+  : control_block{observe(other.control_block)}
+{
+  static_assert(std::is_convertible<T*, element_type*>::value,
+                "Observing pointer of different or non-derived type");
+}
+
+template<typename T, typename P>
+inline owned_observer<T, P>::owned_observer(const owned_observer& other) noexcept
+  : control_block{observe(other.control_block)}
+{}
+
+template<typename T, typename P>
+inline owned_observer<T, P>::owned_observer(owned_observer&& other) noexcept : control_block{other.control_block}
+{
+  other.control_block = nullptr;
+}
+
+template<typename T, typename P>
+inline auto owned_observer<T, P>::operator=(owned_observer other) noexcept -> owned_observer&
+{
+  return swap(other), *this;
+}
+
+template<typename T, typename P>
+inline owned_observer<T, P>::~owned_observer()
+{
+  if(control_block)
+    control_block->release_weak<policy_type>();
+}
+
+/*
+ * Object is gone, when it was deleted by unique_ptr or when last owned_pointer
+ * deleted it before acquisition.
+ */
+template<typename T, typename P>
+inline auto owned_observer<T, P>::expired() const noexcept -> bool
+{
+  if(!control_block)
+    return false;
+
+  const auto state = policy_type::load(control_block->state, std::memory_order_acquire);
+
+  if(state & _priv::control_block::deleted_flag)
+    return true;
+
+  return !(state & _priv::control_block::acquired_flag) &&
+         policy_type::load(control_block->refs, std::memory_order_acquire) == 0;
+}
+
+template<typename T, typename P>
+inline auto owned_observer<T, P>::acquired() const noexcept -> bool
+{
+  return control_block && control_block->acquired<policy_type>();
+}
+
+template<typename T, typename P>
+inline auto owned_observer<T, P>::use_count() const noexcept -> long
+{
+  return control_block ? policy_type::load(control_block->refs, std::memory_order_relaxed) : 0;
+}
+
+template<typename T, typename P>
+inline auto owned_observer<T, P>::lock() const noexcept -> owned_pointer<element_type, policy_type>
+{
+  if(control_block && control_block->try_add_ref<policy_type>())
+    return _priv::access::adopt<owned_pointer<element_type, policy_type>>(control_block);
+
+  return nullptr;
+}
+
+template<typename T, typename P>
+inline void owned_observer<T, P>::swap(owned_observer& other) noexcept
+{
+  std::swap(control_block, other.control_block);
+}
+
+namespace _priv
+{
+
+template<typename Object, typename Alloc, typename... Args>
+inline auto allocate_owned(std::true_type, allocation_site& site, const Alloc& alloc, Args&&... args) -> owned_pointer<Object>
+{
+  return access::adopt<owned_pointer<Object>>(make_fused<Object>(site, alloc, std::forward<Args>(args)...));
+}
+
+template<typename Object, typename Alloc, typename... Args>
+inline auto allocate_owned(std::false_type, allocation_site& site, const Alloc& alloc, Args&&... args) -> owned_pointer<Object>
+{
+  return access::adopt<owned_pointer<Object>>(make_in_place<Object>(site, alloc, std::forward<Args>(args)...));
+}
+
+template<typename Object, typename... Args>
+inline auto make_owned(std::true_type, allocation_site& site, Args&&... args) -> owned_pointer<Object>
+{
+  return _priv::allocate_owned<Object>(std::true_type{}, site, std::allocator<Object>{}, std::forward<Args>(args)...);
+}
+
+template<typename Object, typename... Args>
+inline auto make_owned(std::false_type, allocation_site& site, Args&&... args) -> owned_pointer<Object>
+{
+  std::unique_ptr<Object> object{ new Object{ std::forward<Args>(args)... } };
+  const auto cb = new_block(object.get(), owned_deleter<Object>::operations);
+  count_created(cb, site);
+  register_block(cb);
+
+  return object.release(), access::adopt<owned_pointer<Object>>(cb);
+}
+
+struct objects_in_arena {};
+struct blocks_in_arena {};
+struct nothing_in_arena {};
+
+template<typename Object>
+using arena_strategy = typename std::conditional<
+    _priv::is_expired_enabled<Object>::value,
+    typename std::conditional<alignof(Object) <= alignof(std::max_align_t),
+                              objects_in_arena, nothing_in_arena>::type,
+    blocks_in_arena
+  >::type;
+
+template<typename Object, typename Policy, typename... Args>
+auto make_owned_n(objects_in_arena, allocation_site& site, const std::size_t n, const Args&... args) -> std::vector<owned_pointer<Object, Policy>>
+{
+  using notify_type = destruction_notify_object<Object>;
+  using layout = arena_layout<Object, notify_type>;
+
+  std::vector<owned_pointer<Object, Policy>> pointers;
+  if(pointers.reserve(n), n == 0)
+    return pointers;
+
+  const auto arena = layout::allocate(n);
+
+  for(std::size_t i = 0; i < n; i++)
+  {
+    const auto cb = ::new(layout::slot(arena, i)) control_block{nullptr, layout::operations, 2};
+    layout::arena_of(cb) = arena;
+
+    notify_type* p;
+    try
+    {
+      p = ::new(static_cast<void*>(cb + 1)) notify_type{ args... };
+    }
+    catch(...)
+    {
+      cb->~control_block();
+      arena->release(n - i + 1);
+      throw;
+    }
+
+    cb->ptr = static_cast<Object*>(p);
+    count_created(cb, site);
+    register_block(cb);
+
+    p->link_inline(cb);
+    pointers.push_back(access::adopt<owned_pointer<Object, Policy>>(cb));
+  }
+
+  return arena->release(), pointers;
+}
 
-  template<typename T>
-  auto compare(const owned_pointer<T>& p) const noexcept -> std::int8_t;
+template<typename Object, typename Policy, typename... Args>
+auto make_owned_n(blocks_in_arena, allocation_site& site, const std::size_t n, const Args&... args) -> std::vector<owned_pointer<Object, Policy>>
+{
+  using layout = arena_layout<Object, void>;
 
-private:
-  owned_pointer(element_type *const p, const bool acquired);
+  std::vector<owned_pointer<Object, Policy>> pointers;
+  if(pointers.reserve(n), n == 0)
+    return pointers;
 
-  auto stored_address() const noexcept -> element_type*;
-  void throw_when_ptr_expired_and_object_has_virtual_dtor() const;
+  const auto arena = layout::allocate(n);
 
-  template<typename T, typename = typename std::enable_if<std::is_polymorphic<T>::value, void>::type>
-  auto get_secret_when_possible(T *const p) noexcept -> _priv::shared_secret*
+  for(std::size_t i = 0; i < n; i++)
   {
-    if(auto ss{dynamic_cast<_priv::shared_secret*>(p)})
-      return base_type::operator=(ss->control_block.lock()), ss;
+    Object* p;
+    try
+    {
+      p = new Object{ args... };
+    }
+    catch(...)
+    {
+      arena->release(n - i + 1);
+      throw;
+    }
 
-    return nullptr;
+    const auto cb = ::new(layout::slot(arena, i)) control_block{p, layout::operations, 1};
+    layout::arena_of(cb) = arena;
+    count_created(cb, site);
+    register_block(cb);
+    pointers.push_back(access::adopt<owned_pointer<Object, Policy>>(cb));
   }
 
-  auto get_secret_when_possible(...) noexcept -> _priv::shared_secret*
-  {
-    return nullptr;
-  }
+  return arena->release(), pointers;
+}
 
-  void set_shared_secret_when_possible(_priv::shared_secret *const ss) const
-  {
-    if(ss != nullptr)
-      ss->control_block = *this;
-  }
-};
+template<typename Object, typename Policy, typename... Args>
+auto make_owned_n(nothing_in_arena, allocation_site& site, const std::size_t n, const Args&... args) -> std::vector<owned_pointer<Object, Policy>>
+{
+  std::vector<owned_pointer<Object, Policy>> pointers;
+  pointers.reserve(n);
 
-template<>
-struct owned_pointer<void>
-{};
+  for(std::size_t i = 0; i < n; i++)
+    pointers.push_back(_priv::make_owned<Object>(std::true_type{}, site, args...));
 
-#if __cplusplus >= 201703L
-template<typename T>
-owned_pointer(std::unique_ptr<T>&&) -> owned_pointer<T>;
+  return pointers;
+}
 
-template<typename T>
-owned_pointer(_priv::link_ptr<T>&&) -> owned_pointer<T>;
-#endif
+} // namespace _priv
 
-/*****************************************************************************************
- *
- * Public Exceptions
- *
- *****************************************************************************************/
+template<typename Object, typename... Args>
+inline auto make_owned_at(allocation_site& site, Args&&... args) -> owned_pointer<Object>
+{
+  return _priv::make_owned<Object>(_priv::is_expired_enabled<Object>{}, site, std::forward<Args>(args)...);
+}
 
-struct unique_ptr_already_acquired : public std::runtime_error
+template<typename Object, typename... Args>
+inline auto make_owned(Args&&... args) -> owned_pointer<Object>
 {
-  unique_ptr_already_acquired() : std::runtime_error("owned_pointer: This pointer is already acquired by unique_ptr") {}
-};
+  return make_owned_at<Object>(_priv::unknown_site(), std::forward<Args>(args)...);
+}
 
-struct ptr_is_already_deleted : public std::runtime_error
+template<typename Object, typename Alloc, typename... Args>
+inline auto allocate_owned(const Alloc& alloc, Args&&... args) -> owned_pointer<Object>
 {
-  ptr_is_already_deleted() : std::runtime_error("owned_pointer: This pointer is already deleted") {}
-};
+  return _priv::allocate_owned<Object>(_priv::is_expired_enabled<Object>{}, _priv::unknown_site(), alloc,
+                                       std::forward<Args>(args)...);
+}
 
-/*****************************************************************************************
- *
- * Public member class functions
- *
- *****************************************************************************************/
+template<typename Object, typename... Args>
+inline auto make_owned_n(const std::size_t n, const Args&... args) -> owned_range<Object>
+{
+  return owned_range<Object>{
+      _priv::make_owned_n<Object, thread_safe>(_priv::arena_strategy<Object>{}, _priv::unknown_site(), n, args...)};
+}
 
 template<typename T>
-inline auto owned_pointer<T>::get() const -> element_type*
+inline auto link(const std::unique_ptr<T>& u) noexcept -> _priv::link_ptr<T>
 {
-  throw_when_ptr_expired_and_object_has_virtual_dtor();
-  return stored_address();
+  return _priv::link_ptr<T>{u};
 }
 
-template<typename T>
-inline auto owned_pointer<T>::operator->() const -> element_type*
+template<typename R, typename T>
+inline auto link(const std::unique_ptr<T>& u) noexcept -> _priv::link_ptr<R>
 {
-  return get();
+  return _priv::link_ptr<R>{u};
 }
 
-template<typename T>
-inline auto owned_pointer<T>::operator*() const -> element_type&
+/*
+ * Takes ownership of raw pointer like owned_pointer(std::unique_ptr&&). Object
+ * already tracked by other owned_pointers shares their control block. Object
+ * without virtual dtor is found only by its address in OWNED_POINTER_REGISTRY.
+ */
+template<typename T, typename P = thread_safe>
+inline auto adopt(T *const p) -> owned_pointer<T, P>
 {
-  return *get();
+  return owned_pointer<T, P>{std::unique_ptr<T>{p}};
 }
 
-template<typename T>
-inline auto owned_pointer<T>::unique_ptr() const -> uptr_type
+template<typename To, typename From, typename P>
+inline auto static_pointer_cast(const owned_pointer<From, P>& from) -> owned_pointer<To, P>
 {
-  if(!get())
-    return uptr_type { nullptr };
+  return { from };
+}
 
-  if(acquired())
-    throw unique_ptr_already_acquired();
+#if OWNED_POINTER_RTTI
+template<typename T, typename F, typename P>
+inline auto dynamic_pointer_cast(const owned_pointer<F, P>& from) -> owned_pointer<T, P>
+{
+  static_assert(is_expired_enabled<decltype(from)>::value, "Only possible for polymorphic types");
+
+  if (!from.expired())
+  {
+    if (dynamic_cast<T*>( from.operator->() ))
+    {
+      const auto cb = _priv::access::control_block_of(from);
+      return cb->template add_ref<P>(), _priv::access::adopt<owned_pointer<T, P>>(cb);
+    }
+  }
 
-  return _priv::acquired(base_type::operator*()) = true, uptr_type{stored_address()};
+  return nullptr;
 }
+#endif
 
-template<typename T>
-inline auto owned_pointer<T>::raw_ptr() const -> element_type*
+/*****************************************************************************************
+ *
+ * Public range algorithms
+ *
+ *****************************************************************************************/
+
+namespace _priv
 {
-  return unique_ptr().release();
-}
 
-template<typename T>
-inline auto owned_pointer<T>::acquired() const noexcept -> bool
+/*
+ * Acquisition is locked read-modify-write of control block, which stops
+ * processor from loading blocks of next handles in advance. So block of handle
+ * few positions ahead is prefetched for writing while current one is acquired.
+ * Plain state checks are independent loads and need no help.
+ */
+constexpr std::size_t prefetch_distance = 8;
+
+template<typename Iterator>
+inline void prefetch_next(Iterator& ahead, const Iterator& last) noexcept
 {
-  return base_type::operator bool() && _priv::acquired(base_type::operator*());
+  if(ahead != last)
+  {
+    OWNED_POINTER_PREFETCH(access::existing_block_of(*ahead), 1);
+    ++ahead;
+  }
 }
 
-template<typename T>
-inline auto owned_pointer<T>::expired() const noexcept -> bool
+template<typename Iterator>
+inline auto prefetch_first(Iterator first, const Iterator& last) noexcept -> Iterator
 {
-  return base_type::operator bool() && _priv::deleted(base_type::operator*());
+  for(std::size_t i = 0; i < prefetch_distance; i++)
+    prefetch_next(first, last);
+
+  return first;
 }
 
-template<typename T>
-inline owned_pointer<T>::operator uptr_type() const
+template<typename Pointer>
+inline auto is_deleted(const Pointer& p) noexcept -> bool
 {
-  return unique_ptr();
+  const auto cb = access::existing_block_of(p);
+  return cb && cb->template deleted<typename Pointer::policy_type>();
 }
 
-template<typename T>
-inline owned_pointer<T>::operator bool() const noexcept
+template<typename Iterator>
+using pointer_of = typename std::iterator_traits<Iterator>::value_type;
+
+template<typename Iterator>
+auto acquire_range(const Iterator first, const Iterator last) -> std::vector<typename pointer_of<Iterator>::uptr_type>
 {
-  return stored_address();
+  using policy_type = typename pointer_of<Iterator>::policy_type;
+
+  std::vector<typename pointer_of<Iterator>::uptr_type> objects;
+  objects.reserve(static_cast<std::size_t>(std::distance(first, last)));
+
+  for(auto it = first; it != last; ++it)
+    access::control_block_of(*it); // rollback needs blocks, so they are created before any acquisition
+
+  auto ahead = prefetch_first(first, last);
+
+  for(auto it = first; it != last; ++it)
+  {
+    prefetch_next(ahead, last);
+
+    const auto cb = access::existing_block_of(*it);
+    const auto state = cb ? cb->template try_acquire<policy_type>() : 0;
+
+    if(state & control_block::refused_by_unique)
+    {
+      for(auto& object : objects)
+        object.release();
+
+      for(auto done = first; done != it; ++done)
+        if(const auto acquired = access::existing_block_of(*done))
+          acquired->template set_acquired<policy_type>(false);
+
+      if(state & control_block::deleted_flag)
+        throw ptr_is_already_deleted();
+
+      if(state & control_block::acquired_flag)
+        throw unique_ptr_already_acquired();
+
+      throw unique_ptr_can_not_free_object();
+    }
+
+    objects.emplace_back(cb ? it->get(std::nothrow) : nullptr);
+  }
+
+  for(auto it = first; it != last; ++it)
+    if(const auto cb = access::existing_block_of(*it))
+      count_acquired(cb);
+
+  return objects;
 }
 
-template<typename T>
-inline auto owned_pointer<T>::get(std::nothrow_t) const noexcept -> element_type*
+} // namespace _priv
+
+/*
+ * Acquires every object of range or none of them. When any object is already
+ * acquired or deleted, acquisitions made so far are rolled back and exception
+ * is thrown as by unique_ptr(). Acquired objects are moved to output iterator.
+ */
+template<typename Range, typename OutputIt>
+inline auto acquire_all(const Range& range, OutputIt out) -> OutputIt
 {
-  return expired() ? nullptr : stored_address();
+  using std::begin;
+  using std::end;
+
+  auto objects = _priv::acquire_range(begin(range), end(range));
+  return std::move(objects.begin(), objects.end(), out);
 }
 
-template<typename R> template<typename T>
-inline owned_pointer<R>::operator owned_pointer<T>() const noexcept
+template<typename Range>
+inline auto count_expired(const Range& range) noexcept -> std::size_t
 {
-  static_assert(std::is_convertible<element_type*, T*>::value,
-                "Casting to pointer of different or non-derived type");
+  std::size_t count = 0;
 
-  owned_pointer<T> casted{nullptr};
-  return(static_cast<base_type&>(casted) = *this, casted);
+  for(const auto& p : range)
+    count += _priv::is_deleted(p);
+
+  return count;
 }
 
-template<typename R> template<typename T>
-inline auto owned_pointer<R>::compare(const T& ptr) const noexcept -> std::int8_t
+/*
+ * Removes handles of deleted objects from container, keeping order of the
+ * remaining ones. Returns number of removed handles.
+ */
+template<typename Container>
+inline auto erase_expired(Container& container) -> std::size_t
 {
-  static_assert(std::is_convertible<T, element_type*>::value ||
-                std::is_convertible<element_type*, T>::value,
-                "Comparing pointer of different or non-derived type");
+  using std::begin;
+  using std::end;
+
+  const auto last = end(container);
+  auto out = begin(container);
+
+  for(auto it = begin(container); it != last; ++it)
+  {
+    if(!_priv::is_deleted(*it))
+    {
+      if(out != it)
+        *out = std::move(*it);
+      ++out;
+    }
+  }
 
-  const auto addr{stored_address()};
-  return addr == ptr ? 0 : (addr < ptr ? -1 : +1);
+  const auto removed = static_cast<std::size_t>(std::distance(out, last));
+  return container.erase(out, last), removed;
 }
 
-template<typename R> template<typename T>
-inline auto owned_pointer<R>::compare(const owned_pointer<T>& p) const noexcept -> std::int8_t
+template<typename T, typename P>
+inline auto owned_range<T, P>::acquire_all() const -> std::vector<uptr_type>
 {
-  return compare(p.stored_address());
+  return _priv::acquire_range(pointers.begin(), pointers.end());
 }
+
+#ifdef OWNED_POINTER_STATISTICS
 /*****************************************************************************************
  *
- * Private member class functions
+ * Public lifecycle statistics
  *
  *****************************************************************************************/
 
-template<typename T>
-auto owned_pointer<T>::stored_address() const noexcept -> element_type*
+/*
+ * Lifecycle events of objects tracked by owned_pointer. Objects are alive until
+ * they are deleted by owned_pointer or their deletion by unique_ptr is seen,
+ * which is possible only for types with virtual dtor.
+ */
+struct lifecycle_counters
 {
-  return base_type::operator bool() ?
-       static_cast<element_type*>(_priv::ptr(base_type::operator*())) : nullptr;
+  std::size_t created = 0;
+  std::size_t acquired = 0;
+  std::size_t expired = 0;
+  std::size_t never_acquired = 0;
+  std::size_t live_objects = 0;
+  std::size_t live_bytes = 0;
+};
+
+namespace _priv
+{
+
+inline void add_statistics(lifecycle_counters& counters, const type_statistics& type) noexcept
+{
+  std::size_t events[lifecycle_events];
+
+  for(unsigned e = 0; e < lifecycle_events; e++)
+    events[e] = type.retired[e];
+
+  for(auto t = type.threads; t; t = t->next)
+    for(unsigned e = 0; e < lifecycle_events; e++)
+      events[e] += t->events[e].load(std::memory_order_relaxed);
+
+  const auto live = counted_difference(events[created_event], events[expired_event] + events[never_acquired_event]);
+
+  counters.created += events[created_event];
+  counters.acquired += events[acquired_event];
+  counters.expired += events[expired_event];
+  counters.never_acquired += events[never_acquired_event];
+  counters.live_objects += live;
+  counters.live_bytes += live * type.object_size;
 }
 
+} // namespace _priv
+
+/*
+ * Snapshot of counters of all threads for objects created as T.
+ */
 template<typename T>
-void owned_pointer<T>::throw_when_ptr_expired_and_object_has_virtual_dtor() const
+inline auto lifecycle_snapshot() -> lifecycle_counters
 {
-  if(expired())
-    throw ptr_is_already_deleted();
+  auto& registry = _priv::statistics_registry::instance();
+  std::lock_guard<std::mutex> guard{registry.lock};
+
+  lifecycle_counters counters;
+  _priv::add_statistics(counters, _priv::statistics_of<T>::instance);
+
+  return counters;
 }
 
-template<typename T>
-owned_pointer<T>::owned_pointer(element_type *const p, const bool acquired)
+/*
+ * Snapshot of counters of all threads summed over all types.
+ */
+inline auto lifecycle_snapshot() -> lifecycle_counters
 {
-  if(!p) return;
-  const auto ss = get_secret_when_possible(p);
+  auto& registry = _priv::statistics_registry::instance();
+  std::lock_guard<std::mutex> guard{registry.lock};
 
-  if(!base_type::operator bool())
-  {
-    base_type::reset(
-      new _priv::control_block_type(p, {}, {}),
-      _priv::owned_deleter<element_type>()
-    );
-    set_shared_secret_when_possible(ss);
-  }
-  _priv::acquired(base_type::operator*()) = acquired;
+  lifecycle_counters counters;
+  for(auto type = registry.types; type; type = type->next)
+    _priv::add_statistics(counters, *type);
+
+  return counters;
 }
+#endif
 
+#ifdef OWNED_POINTER_SITE_REPORT
 /*****************************************************************************************
  *
- * Public non-member functions
+ * Public allocation site report
  *
  *****************************************************************************************/
 
-template<typename T>
-struct is_expired_enabled {};
-
-template<typename T>
-struct is_expired_enabled<owned_pointer<T>> : _priv::is_expired_enabled<T> {};
+/*
+ * Objects of single site, which were freed without being acquired or are
+ * still alive. Deletion by unique_ptr is seen only for types with virtual dtor,
+ * so other acquired objects stay alive in report.
+ */
+struct allocation_site_report
+{
+  const char* file;
+  unsigned line;
+  std::size_t created;
+  std::size_t never_acquired;
+  std::size_t alive_unacquired;
+  std::size_t alive_acquired;
+};
 
-template<typename T>
-struct is_expired_enabled<owned_pointer<T>&> : _priv::is_expired_enabled<T> {};
+namespace _priv
+{
 
-template<typename T>
-struct is_expired_enabled<owned_pointer<T>&&> : _priv::is_expired_enabled<T> {};
+inline void print_allocation_report_at_exit();
 
-template<typename T>
-struct is_expired_enabled<const owned_pointer<T>> : _priv::is_expired_enabled<T> {};
+struct site_registry
+{
+  std::mutex lock;
+  allocation_site* sites;
 
-template<typename T>
-struct is_expired_enabled<const owned_pointer<T>&> : _priv::is_expired_enabled<T> {};
+  static auto instance() noexcept -> site_registry&
+  {
+    static site_registry registry{};
+    static const bool report_registered = std::atexit(&print_allocation_report_at_exit) == 0;
 
-template<typename T>
-struct is_expired_enabled<const owned_pointer<T>&&> : _priv::is_expired_enabled<T> {};
+    return (void)report_registered, registry;
+  }
+};
 
-#if __cplusplus >= 201402L
-template<typename T>
-constexpr bool is_expired_enabled_v{is_expired_enabled<T>::value};
-#endif
+} // namespace _priv
 
-template<typename T, typename = typename std::enable_if<_priv::is_expired_enabled<T>::value, void>::type>
-inline bool is_expired_enabled_f(const owned_pointer<T>& p) noexcept
+inline allocation_site::allocation_site(const char *const f, const unsigned l) noexcept
+  : events{}, next{nullptr}, file{f}, line{l}
 {
-  return p.expired() || nullptr != dynamic_cast<_priv::shared_secret*>(p.operator->());
-}
+  auto& registry = _priv::site_registry::instance();
+  std::lock_guard<std::mutex> guard{registry.lock};
 
-template<typename T>
-inline bool is_expired_enabled_f(const T&) noexcept
-{
-  return false;
+  next = registry.sites;
+  registry.sites = this;
 }
 
-template<typename Object, typename... Args>
-inline auto make_owned(Args&&... args) -> owned_pointer<Object>
+/*
+ * Sites with objects, which were never acquired or are still alive.
+ */
+inline auto allocation_report() -> std::vector<allocation_site_report>
 {
-  using C = std::conditional<
-               _priv::is_expired_enabled<Object>::value,
-               _priv::destruction_notify_object<Object> ,
-               Object
-            >;
+  auto& registry = _priv::site_registry::instance();
+  std::lock_guard<std::mutex> guard{registry.lock};
 
-  return std::unique_ptr<Object>(
-                  new typename C::type{ std::forward<Args>(args)... });
-}
+  std::vector<allocation_site_report> report;
 
-template<typename T>
-inline auto link(const std::unique_ptr<T>& u) noexcept -> _priv::link_ptr<T>
-{
-  return _priv::link_ptr<T>{u};
+  for(auto site = registry.sites; site; site = site->next)
+  {
+    std::size_t events[_priv::lifecycle_events];
+    for(unsigned e = 0; e < _priv::lifecycle_events; e++)
+      events[e] = site->events[e].load(std::memory_order_relaxed);
+
+    const auto never_acquired = events[_priv::never_acquired_event];
+    const auto alive_unacquired = _priv::counted_difference(events[_priv::created_event],
+                                                            events[_priv::acquired_event] + never_acquired);
+    const auto alive_acquired = _priv::counted_difference(events[_priv::acquired_event], events[_priv::expired_event]);
+
+    if(never_acquired || alive_unacquired || alive_acquired)
+      report.push_back({site->file, site->line, events[_priv::created_event], never_acquired, alive_unacquired, alive_acquired});
+  }
+
+  return report;
 }
 
-template<typename R, typename T>
-inline auto link(const std::unique_ptr<T>& u) noexcept -> _priv::link_ptr<R>
+inline void print_allocation_report(std::FILE *const out = stderr)
 {
-  return _priv::link_ptr<R>{u};
+  const auto report = allocation_report();
+  if(report.empty())
+    return;
+
+  std::fprintf(out, "owned_pointer: objects never acquired or still alive, grouped by site\n");
+  std::fprintf(out, "%10s %16s %18s %16s  %s\n", "created", "never_acquired", "alive_unacquired", "alive_acquired", "site");
+
+  for(const auto& site : report)
+    std::fprintf(out, "%10zu %16zu %18zu %16zu  %s:%u\n",
+                 site.created, site.never_acquired, site.alive_unacquired, site.alive_acquired, site.file, site.line);
 }
 
-template<typename To, typename From>
-inline auto static_pointer_cast(const owned_pointer<From>& from) noexcept -> owned_pointer<To>
+inline void _priv::print_allocation_report_at_exit()
 {
-  return { from };
+  print_allocation_report(stderr);
 }
+#endif
+
+#ifdef OWNED_POINTER_TRACING
+/*****************************************************************************************
+ *
+ * Public lifecycle trace
+ *
+ *****************************************************************************************/
 
-template<typename T, typename F>
-inline auto dynamic_pointer_cast(const owned_pointer<F>& from) noexcept -> owned_pointer<T>
+/*
+ * Writes events of all threads in Chrome trace format, which is also read by
+ * Perfetto. Lifetime of every object is async slice identified by address of
+ * its control block, copies and acquisition are instant events inside it.
+ * Events pushed while buffers are written out may be missing.
+ */
+inline void write_chrome_trace(std::FILE *const out)
 {
-  static_assert(is_expired_enabled<decltype(from)>::value, "Only possible for polymorphic types");
+  static const char *const names[] = {"object", "acquired", "object", "object", "copied"};
+  static const char *const reasons[] = {"created", "acquired", "expired", "never acquired", "copied"};
+  static const char phases[] = {'b', 'n', 'e', 'e', 'n'};
 
-  if (!from.expired())
+  auto& registry = _priv::trace_registry::instance();
+  std::lock_guard<std::mutex> guard{registry.lock};
+
+  const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - registry.start_time;
+  const auto ticks = _priv::trace_clock() - registry.start_ticks;
+  const auto microseconds_per_tick = ticks ? elapsed.count() / ticks : 0.0;
+
+  const char* separator = "";
+  std::fprintf(out, "{\"traceEvents\":[");
+
+  for(auto buffer = registry.buffers; buffer; buffer = buffer->next)
   {
-    if (auto p = dynamic_cast<T*>( from.operator->() ))
+    const auto head = buffer->head.load(std::memory_order_acquire);
+    const auto first = head > _priv::trace_capacity ? head - _priv::trace_capacity : 0;
+
+    for(auto i = first; i < head; i++)
     {
-      return std::unique_ptr<T>{p};
+      const auto& record = buffer->records[i & (_priv::trace_capacity - 1)];
+      const auto time = record.time.load(std::memory_order_relaxed);
+      const auto value = record.block_and_event.load(std::memory_order_relaxed);
+
+      if(i + _priv::trace_capacity <= buffer->head.load(std::memory_order_acquire))
+        continue; // overwritten while being read
+
+      const auto event = value & 7u;
+      const auto block = value & ~static_cast<std::uintptr_t>(7u);
+
+      const auto since_start = static_cast<std::int64_t>(time - registry.start_ticks);
+
+      std::fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"owned_pointer\",\"ph\":\"%c\",\"id\":\"0x%llx\","
+                        "\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"event\":\"%s\"}}",
+                   separator, names[event], phases[event], static_cast<unsigned long long>(block),
+                   since_start * microseconds_per_tick, buffer->thread, reasons[event]);
+      separator = ",";
     }
   }
 
-  return nullptr;
+  std::fprintf(out, "\n]}\n");
 }
+#endif
 
 /*****************************************************************************************
  *
@@ -468,112 +2944,192 @@ inline auto dynamic_pointer_cast(const owned_pointer<F>& from) noexcept -> owned
  *
  *****************************************************************************************/
 
-template<typename A>
-inline bool operator==(const owned_pointer<A>& p1, std::nullptr_t) noexcept
+template<typename A, typename P>
+inline bool operator==(const owned_pointer<A, P>& p1, std::nullptr_t) noexcept
 {
   return p1.compare(nullptr) == 0;
 }
 
-template<typename A>
-inline bool operator!=(const owned_pointer<A>& p1, std::nullptr_t) noexcept
+template<typename A, typename P>
+inline bool operator!=(const owned_pointer<A, P>& p1, std::nullptr_t) noexcept
 {
   return p1.compare(nullptr) != 0;
 }
 
-template<typename A>
-inline bool operator==(std::nullptr_t, const owned_pointer<A>& p1) noexcept
+template<typename A, typename P>
+inline bool operator==(std::nullptr_t, const owned_pointer<A, P>& p1) noexcept
 {
   return p1 == nullptr;
 }
 
-template<typename A>
-inline bool operator!=(std::nullptr_t, const owned_pointer<A>& p1) noexcept
+template<typename A, typename P>
+inline bool operator!=(std::nullptr_t, const owned_pointer<A, P>& p1) noexcept
 {
   return p1 != nullptr;
 }
 
-template<typename A, typename B>
-inline bool operator==(const owned_pointer<A>& p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P, typename Q>
+inline bool operator==(const owned_pointer<A, P>& p1, const owned_pointer<B, Q>& p2) noexcept
 {
   return p1.compare(p2) == 0;
 }
 
-template<typename A, typename B>
-inline bool operator!=(const owned_pointer<A>& p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P, typename Q>
+inline bool operator!=(const owned_pointer<A, P>& p1, const owned_pointer<B, Q>& p2) noexcept
 {
   return !(p1 == p2);
 }
 
-template<typename A, typename B>
-inline bool operator<(const owned_pointer<A>& p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P, typename Q>
+inline bool operator<(const owned_pointer<A, P>& p1, const owned_pointer<B, Q>& p2) noexcept
 {
   return p1.compare(p2) < 0;
 }
 
-template<typename A, typename B>
-inline bool operator<=(const owned_pointer<A>& p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P, typename Q>
+inline bool operator<=(const owned_pointer<A, P>& p1, const owned_pointer<B, Q>& p2) noexcept
 {
   return p1.compare(p2) <= 0;
 }
 
-template<typename A, typename B>
-inline bool operator>(const owned_pointer<A>& p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P, typename Q>
+inline bool operator>(const owned_pointer<A, P>& p1, const owned_pointer<B, Q>& p2) noexcept
 {
   return p1.compare(p2) > 0;
 }
 
-template<typename A, typename B>
-inline bool operator>=(const owned_pointer<A>& p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P, typename Q>
+inline bool operator>=(const owned_pointer<A, P>& p1, const owned_pointer<B, Q>& p2) noexcept
 {
   return p1.compare(p2) >= 0;
 }
 
-template<typename A, typename B>
-inline bool operator==(const owned_pointer<A>& p1, const B* p2) noexcept
+template<typename A, typename B, typename P>
+inline bool operator==(const owned_pointer<A, P>& p1, const B* p2) noexcept
 {
   return p1.compare(p2) == 0;
 }
 
-template<typename A, typename B>
-inline bool operator==(const A* p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P>
+inline bool operator==(const A* p1, const owned_pointer<B, P>& p2) noexcept
 {
   return p2.compare(p1) == 0;
 }
 
-template<typename A, typename B>
-inline bool operator!=(const owned_pointer<A>& p1, const B* p2) noexcept
+template<typename A, typename B, typename P>
+inline bool operator!=(const owned_pointer<A, P>& p1, const B* p2) noexcept
 {
   return p1.compare(p2) != 0;
 }
 
-template<typename A, typename B>
-inline bool operator!=(const A* p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P>
+inline bool operator!=(const A* p1, const owned_pointer<B, P>& p2) noexcept
 {
   return p2.compare(p1) != 0;
 }
 
-template<typename A, typename B>
-inline bool operator==(const owned_pointer<A>& p1, const std::unique_ptr<B>& p2) noexcept
+template<typename A, typename B, typename P>
+inline bool operator==(const owned_pointer<A, P>& p1, const std::unique_ptr<B>& p2) noexcept
 {
   return p1.compare(p2.get()) == 0;
 }
 
-template<typename A, typename B>
-inline bool operator==(const std::unique_ptr<A>& p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P>
+inline bool operator==(const std::unique_ptr<A>& p1, const owned_pointer<B, P>& p2) noexcept
 {
   return p2.compare(p1.get()) == 0;
 }
 
-template<typename A, typename B>
-inline bool operator!=(const owned_pointer<A>& p1, const std::unique_ptr<B>& p2) noexcept
+template<typename A, typename B, typename P>
+inline bool operator!=(const owned_pointer<A, P>& p1, const std::unique_ptr<B>& p2) noexcept
 {
   return p1.compare(p2.get()) != 0;
 }
 
-template<typename A, typename B>
-inline bool operator!=(const std::unique_ptr<A>& p1, const owned_pointer<B>& p2) noexcept
+template<typename A, typename B, typename P>
+inline bool operator!=(const std::unique_ptr<A>& p1, const owned_pointer<B, P>& p2) noexcept
 {
   return p2.compare(p1.get()) != 0;
 }
 
+} // inline namespace of configuration
+} //namespace csp
+
+namespace csp
+{
+namespace _config
+{
+
+/* Values of defines, sizes of features which are off are 0 */
+struct configuration
+{
+  unsigned features;
+  std::size_t block_pool;
+  std::size_t trace_capacity;
+  std::size_t registry_shards;
+  std::size_t registry_filter;
+  bool assert_dtor;
+};
+
+inline auto operator==(const configuration& a, const configuration& b) noexcept -> bool
+{
+  return a.features == b.features && a.block_pool == b.block_pool && a.trace_capacity == b.trace_capacity &&
+         a.registry_shards == b.registry_shards && a.registry_filter == b.registry_filter &&
+         a.assert_dtor == b.assert_dtor;
+}
+
+/* Outside of inline namespace, so it is one function for every configuration */
+inline auto first_configuration(const configuration& config) noexcept -> const configuration&
+{
+  static const configuration first = config;
+  return first;
+}
+
+/* Every unit has its own check, so it sees defines of that unit */
+namespace
+{
+
+constexpr configuration configuration_of_this_unit{
+  OWNED_POINTER_CONFIG,
+  OWNED_POINTER_BLOCK_POOL,
+#ifdef OWNED_POINTER_TRACING
+  OWNED_POINTER_TRACE_CAPACITY,
+#else
+  0,
+#endif
+#ifdef OWNED_POINTER_REGISTRY
+  OWNED_POINTER_REGISTRY_SHARDS,
+  OWNED_POINTER_REGISTRY_FILTER,
+#else
+  0,
+  0,
+#endif
+#ifdef OWNED_POINTER_ASSERT_DTOR
+  true
+#else
+  false
+#endif
+};
+
+struct configuration_check
+{
+  configuration_check() noexcept
+  {
+    if(first_configuration(configuration_of_this_unit) == configuration_of_this_unit)
+      return;
+
+    std::fputs("owned_pointer: translation units are compiled with different OWNED_POINTER_STATISTICS, "
+               "OWNED_POINTER_SITE_REPORT, OWNED_POINTER_TRACING, OWNED_POINTER_REGISTRY, "
+               "OWNED_POINTER_DELETE_HOOK, OWNED_POINTER_BLOCK_POOL, OWNED_POINTER_TRACE_CAPACITY, "
+               "OWNED_POINTER_REGISTRY_SHARDS, OWNED_POINTER_REGISTRY_FILTER or "
+               "OWNED_POINTER_ASSERT_DTOR defines\n", stderr);
+    std::abort();
+  }
+};
+
+const configuration_check check_of_this_unit{};
+
+}
+
+} // namespace _config
 } //namespace csp
@@ -0,0 +1,127 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#define OWNED_POINTER_DELETE_HOOK
+
+#include <gtest/gtest.h>
+
+#include "owned_pointer.hpp"
+
+OWNED_POINTER_DEFINE_DELETE_HOOK()
+
+class owned_pointer_delete_hook_ut : public ::testing::Test
+{
+protected:
+  struct plain
+  {
+    int value;
+  };
+
+  /* Every object takes the same memory, what replaced operator delete would see is forwarded */
+  struct reused
+  {
+    static auto operator new(const std::size_t size) -> void*
+    {
+      static_assert(sizeof(reused) <= sizeof(memory), "memory is too small");
+      assert(size <= sizeof(memory) && !taken);
+      (void)size;
+      taken = true;
+      return memory;
+    }
+
+    static void operator delete(void *const p) noexcept
+    {
+      csp::_priv::notify_operator_delete(p);
+      taken = false;
+    }
+
+    int value;
+
+    alignas(std::max_align_t) static unsigned char memory[64];
+    static bool taken;
+  };
+};
+
+alignas(std::max_align_t) unsigned char owned_pointer_delete_hook_ut::reused::memory[64];
+bool owned_pointer_delete_hook_ut::reused::taken = false;
+
+TEST_F(owned_pointer_delete_hook_ut, detectsDeletionOfObjectWithoutVirtualDtor)
+{
+  const auto p = csp::make_owned<plain>();
+  ASSERT_FALSE(p.expired());
+
+  p.unique_ptr().reset();
+
+  ASSERT_TRUE(p.expired());
+  ASSERT_EQ(p.get(std::nothrow), nullptr);
+  ASSERT_THROW(p.get(), csp::ptr_is_already_deleted);
+  ASSERT_THROW(p.unique_ptr(), csp::ptr_is_already_deleted);
+}
+
+TEST_F(owned_pointer_delete_hook_ut, detectsDeletionOfLinkedObject)
+{
+  auto u = std::unique_ptr<plain>(new plain{});
+  const csp::owned_pointer<plain> p{csp::link(u)};
+
+  u.reset();
+  ASSERT_TRUE(p.expired());
+}
+
+TEST_F(owned_pointer_delete_hook_ut, deletedAddressIsNotSharedWithNewObject)
+{
+  auto u = std::unique_ptr<reused>(new reused{});
+  const auto address = u.get();
+  const csp::owned_pointer<reused> p{csp::link(u)};
+  u.reset();
+
+  u.reset(new reused{});
+  ASSERT_EQ(u.get(), address);
+  const csp::owned_pointer<reused> r{csp::link(u)};
+
+  ASSERT_TRUE(p.expired());
+  ASSERT_FALSE(r.expired());
+  ASSERT_EQ(r.use_count(), 1);
+
+  u.reset();
+  ASSERT_TRUE(r.expired());
+}
+
+TEST_F(owned_pointer_delete_hook_ut, objectsOfRangeAreTracked)
+{
+  auto range = csp::make_owned_n<plain>(3);
+  range[1].unique_ptr().reset();
+
+  ASSERT_FALSE(range[0].expired());
+  ASSERT_TRUE(range[1].expired());
+  ASSERT_EQ(csp::count_expired(range), 1u);
+}
+
+TEST_F(owned_pointer_delete_hook_ut, uncheckedPolicyStillSkipsCheck)
+{
+  const csp::owned_pointer<plain, csp::unchecked<>> p = csp::make_owned<plain>();
+  const auto address = p.get();
+  p.unique_ptr().reset();
+
+  ASSERT_TRUE(p.expired());
+  ASSERT_EQ(p.get(), address);
+}
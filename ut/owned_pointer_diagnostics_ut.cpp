@@ -0,0 +1,118 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#define OWNED_POINTER_STATISTICS
+#define OWNED_POINTER_SITE_REPORT
+#define OWNED_POINTER_TRACING
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string>
+
+#include "owned_pointer.hpp"
+
+class owned_pointer_diagnostics_ut : public ::testing::Test
+{
+protected:
+  struct polymorphic
+  {
+    virtual ~polymorphic() = default;
+  };
+
+  struct plain
+  {
+    int value;
+  };
+
+  auto created_at(const csp::allocation_site& site) -> std::size_t
+  {
+    const auto report = csp::allocation_report();
+    const auto it = std::find_if(report.begin(), report.end(), [&site](const csp::allocation_site_report& r)
+    {
+      return r.line == site.line && std::strcmp(r.file, site.file) == 0;
+    });
+
+    return it != report.end() ? it->created : 0;
+  }
+
+  auto trace() -> std::string
+  {
+    const auto file = std::tmpfile();
+    csp::write_chrome_trace(file);
+
+    std::string text(static_cast<std::size_t>(std::ftell(file)), '\0');
+    std::rewind(file);
+    text.resize(std::fread(&text[0], 1, text.size(), file));
+
+    return std::fclose(file), text;
+  }
+
+  auto count(const std::string& text, const std::string& what) -> std::size_t
+  {
+    std::size_t n = 0;
+    for(auto i = text.find(what); i != std::string::npos; i = text.find(what, i + 1))
+      n++;
+
+    return n;
+  }
+};
+
+TEST_F(owned_pointer_diagnostics_ut, creationIsCountedOnceBySiteAndStatistics)
+{
+  auto& site = OWNED_POINTER_SITE;
+  const auto before = csp::lifecycle_snapshot<polymorphic>();
+
+  auto p = csp::make_owned_at<polymorphic>(site);
+  auto r = csp::make_owned_at<polymorphic>(site);
+  p.unique_ptr();
+  r = nullptr;
+
+  const auto after = csp::lifecycle_snapshot<polymorphic>();
+  ASSERT_EQ(after.created - before.created, 2u);
+  ASSERT_EQ(after.live_objects, before.live_objects);
+  ASSERT_EQ(created_at(site), 2u);
+}
+
+TEST_F(owned_pointer_diagnostics_ut, everyWayOfCreationIsCountedOnce)
+{
+  const auto before = csp::lifecycle_snapshot();
+  {
+    auto p = csp::make_owned<plain>();
+    auto r = csp::allocate_owned<polymorphic>(std::allocator<polymorphic>{});
+    auto range = csp::make_owned_n<polymorphic>(2);
+    auto plain_range = csp::make_owned_n<plain>(2);
+    csp::owned_pointer<plain> u{std::unique_ptr<plain>(new plain{})};
+
+    ASSERT_EQ(csp::lifecycle_snapshot().created - before.created, 7u);
+  }
+
+  const auto after = csp::lifecycle_snapshot();
+  ASSERT_EQ(after.created - before.created, 7u);
+  ASSERT_EQ(after.live_objects, before.live_objects);
+
+  const auto text = trace();
+  ASSERT_EQ(count(text, "\"ph\":\"b\""), count(text, "\"ph\":\"e\""));
+}
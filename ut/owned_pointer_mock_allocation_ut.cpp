@@ -0,0 +1,111 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#include <gmock/gmock.h>
+
+#include "gmock_macros_for_unique_ptr.hpp"
+#include "allocation_counter.hpp"
+
+using namespace ::testing;
+
+class owned_pointer_mock_allocation_ut : public ::testing::Test
+{
+protected:
+  struct item
+  {
+    virtual ~item() = default;
+  };
+
+  struct consumer
+  {
+    virtual int take(int, int) const = 0;
+    virtual int give(int, std::unique_ptr<item>) const = 0;
+    virtual ~consumer() = default;
+  };
+
+  struct consumer_mock : public consumer
+  {
+    MOCK_METHOD(int, take, (int, int), (const, override));
+    MOCK_UNIQUE_METHOD(int, give, (int, std::unique_ptr<item>), (const, override));
+  };
+
+  /* gmock allocates inside of every call, so it is measured by the same call without unique_ptr */
+  auto allocations_of_plain_call() -> std::size_t
+  {
+    const auto before = allocation_count();
+    base.take(1, 2);
+    return allocation_count() - before;
+  }
+
+  auto allocations_of_unique_call() -> std::size_t
+  {
+    auto u = std::unique_ptr<item>(new item);
+    const auto before = allocation_count();
+    base.give(1, std::move(u));
+    return allocation_count() - before;
+  }
+
+  consumer_mock mock;
+  consumer& base{mock};
+};
+
+TEST_F(owned_pointer_mock_allocation_ut, forwardingUniquePtrToMockAllocatesNothing)
+{
+  EXPECT_CALL(mock, take(1, _)).WillRepeatedly(Return(2));
+  EXPECT_CALL(mock, _give(1, NotNull())).WillRepeatedly(Return(2));
+  allocations_of_plain_call(), allocations_of_unique_call();
+
+  for(int i = 0; i < 3; i++)
+    ASSERT_EQ(allocations_of_unique_call(), allocations_of_plain_call());
+}
+
+TEST_F(owned_pointer_mock_allocation_ut, actionCopyingArgumentReusesPooledBlock)
+{
+  int saved_int;
+  csp::owned_pointer<item> saved;
+  EXPECT_CALL(mock, take(1, _)).WillRepeatedly(DoAll(SaveArg<1>(&saved_int), Return(2)));
+  EXPECT_CALL(mock, _give(1, NotNull())).WillRepeatedly(DoAll(SaveArg<1>(&saved), Return(2)));
+  allocations_of_plain_call(), allocations_of_unique_call();
+
+  for(int i = 0; i < 3; i++)
+  {
+    saved = nullptr;
+    ASSERT_EQ(allocations_of_unique_call(), allocations_of_plain_call());
+    ASSERT_EQ(saved.use_count(), 1);
+    ASSERT_FALSE(saved.acquired());
+  }
+}
+
+TEST_F(owned_pointer_mock_allocation_ut, blockOfCopiedPointerComesFromPool)
+{
+  auto warm_up = csp::owned_pointer<item>{std::unique_ptr<item>(new item)};
+  csp::owned_pointer<item>{warm_up};
+  warm_up = nullptr;
+
+  auto p = csp::owned_pointer<item>{std::unique_ptr<item>(new item)};
+  const auto before = allocation_count();
+  const auto copy = p;
+
+  ASSERT_EQ(allocation_count(), before);
+  ASSERT_EQ(p.use_count(), 2);
+}
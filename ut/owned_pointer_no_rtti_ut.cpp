@@ -0,0 +1,64 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#include <gtest/gtest.h>
+
+#include "owned_pointer.hpp"
+
+static_assert(!OWNED_POINTER_RTTI, "unit has to be compiled without RTTI");
+
+class owned_pointer_no_rtti_ut : public ::testing::Test
+{
+protected:
+  struct polymorphic
+  {
+    virtual ~polymorphic() = default;
+  };
+};
+
+TEST_F(owned_pointer_no_rtti_ut, objectGivenBackSharesBlockWithOwners)
+{
+  const auto p = csp::make_owned<polymorphic>();
+  csp::owned_pointer<polymorphic> back{p.unique_ptr()};
+  ASSERT_EQ(back.use_count(), 2);
+
+  back.unique_ptr().reset();
+  ASSERT_TRUE(p.expired());
+  ASSERT_TRUE(back.expired());
+}
+
+TEST_F(owned_pointer_no_rtti_ut, observerFollowsObjectGivenBackAfterLastOwnerIsGone)
+{
+  auto p = csp::make_owned<polymorphic>();
+  const csp::owned_observer<polymorphic> observer = p;
+
+  auto object = p.unique_ptr();
+  p = nullptr;
+
+  csp::owned_pointer<polymorphic> back{std::move(object)};
+  ASSERT_EQ(observer.lock().get(), back.get());
+
+  back.unique_ptr().reset();
+  ASSERT_TRUE(back.expired());
+  ASSERT_TRUE(observer.expired());
+}
@@ -0,0 +1,116 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#define OWNED_POINTER_REGISTRY
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "owned_pointer.hpp"
+
+class owned_pointer_registry_ut : public ::testing::Test
+{
+protected:
+  struct polymorphic
+  {
+    virtual ~polymorphic() = default;
+  };
+
+  struct plain
+  {
+    int value;
+  };
+};
+
+TEST_F(owned_pointer_registry_ut, linkSharesBlockOfObjectWithoutVirtualDtor)
+{
+  auto u = std::unique_ptr<plain>(new plain{});
+  csp::owned_pointer<plain> p{csp::link(u)};
+  csp::owned_pointer<plain> r{csp::link(u)};
+
+  ASSERT_EQ(p.use_count(), 2);
+  ASSERT_TRUE(r.acquired());
+  ASSERT_THROW(r.unique_ptr(), csp::unique_ptr_already_acquired);
+}
+
+TEST_F(owned_pointer_registry_ut, adoptFindsObjectCreatedByMakeOwned)
+{
+  const auto p = csp::make_owned<plain>();
+  const auto r = csp::adopt(p.get());
+
+  ASSERT_EQ(r, p);
+  ASSERT_EQ(p.use_count(), 2);
+
+  const auto q = csp::make_owned<polymorphic>();
+  ASSERT_EQ(csp::adopt(q.get()).use_count(), 2);
+}
+
+TEST_F(owned_pointer_registry_ut, adoptTakesOwnershipOfUntrackedObject)
+{
+  const auto raw = new plain{};
+  auto p = csp::adopt(raw);
+
+  ASSERT_EQ(p.use_count(), 1);
+  ASSERT_FALSE(p.acquired());
+
+  auto u = std::unique_ptr<plain>{new plain{}};
+  p = std::move(u);
+  ASSERT_EQ(csp::adopt(p.get()).use_count(), 2);
+}
+
+TEST_F(owned_pointer_registry_ut, blockIsForgottenWithItsLastOwner)
+{
+  auto u = std::unique_ptr<plain>(new plain{});
+  csp::owned_pointer<plain>{csp::link(u)};
+
+  csp::owned_pointer<plain> p{csp::link(u)};
+  ASSERT_EQ(p.use_count(), 1);
+}
+
+TEST_F(owned_pointer_registry_ut, handOffFromManyThreadsSharesOneBlockPerObject)
+{
+  constexpr int threads = 4;
+  constexpr int objects = 1000;
+
+  std::vector<csp::owned_pointer<plain>> pointers;
+  for(int i = 0; i < objects; i++)
+    pointers.push_back(csp::make_owned<plain>());
+
+  std::vector<std::thread> workers;
+  for(int t = 0; t < threads; t++)
+    workers.emplace_back([&pointers]
+    {
+      for(int round = 0; round < 10; round++)
+        for(const auto& p : pointers)
+          if(csp::adopt(p.get()) != p)
+            std::abort();
+    });
+
+  for(auto& w : workers)
+    w.join();
+
+  for(const auto& p : pointers)
+    ASSERT_EQ(p.use_count(), 1);
+}
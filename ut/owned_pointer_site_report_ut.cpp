@@ -0,0 +1,123 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#define OWNED_POINTER_SITE_REPORT
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <algorithm>
+
+#include "owned_pointer.hpp"
+
+class owned_pointer_site_report_ut : public ::testing::Test
+{
+protected:
+  struct polymorphic
+  {
+    virtual ~polymorphic() = default;
+  };
+
+  struct plain
+  {
+    int value;
+  };
+
+  auto report_of(const csp::allocation_site& site) -> csp::allocation_site_report
+  {
+    const auto report = csp::allocation_report();
+    const auto it = std::find_if(report.begin(), report.end(), [&site](const csp::allocation_site_report& r)
+    {
+      return r.line == site.line && std::strcmp(r.file, site.file) == 0;
+    });
+
+    return it != report.end() ? *it : csp::allocation_site_report{site.file, site.line, 0, 0, 0, 0};
+  }
+};
+
+TEST_F(owned_pointer_site_report_ut, groupsObjectsBySite)
+{
+  auto& site = OWNED_POINTER_SITE;
+
+  std::vector<csp::owned_pointer<polymorphic>> pointers;
+  for(int i = 0; i < 5; i++)
+    pointers.push_back(csp::make_owned_at<polymorphic>(site));
+
+  auto u = pointers[0].unique_ptr();
+  pointers[1].unique_ptr();
+  pointers.pop_back();
+
+  const auto report = report_of(site);
+  ASSERT_EQ(report.created, 5u);
+  ASSERT_EQ(report.never_acquired, 1u);
+  ASSERT_EQ(report.alive_unacquired, 2u);
+  ASSERT_EQ(report.alive_acquired, 1u);
+
+  u.reset();
+  pointers.clear();
+  ASSERT_EQ(report_of(site).alive_acquired, 0u);
+  ASSERT_EQ(report_of(site).never_acquired, 3u);
+}
+
+TEST_F(owned_pointer_site_report_ut, siteWithoutProblemsIsNotReported)
+{
+  auto& site = OWNED_POINTER_SITE;
+  csp::make_owned_at<polymorphic>(site).unique_ptr();
+
+  const auto report = csp::allocation_report();
+  ASSERT_TRUE(std::none_of(report.begin(), report.end(), [&site](const csp::allocation_site_report& r)
+  {
+    return r.line == site.line && std::strcmp(r.file, site.file) == 0;
+  }));
+}
+
+TEST_F(owned_pointer_site_report_ut, acquiredObjectsWithoutVirtualDtorStayAlive)
+{
+  auto& site = OWNED_POINTER_SITE;
+  delete csp::make_owned_at<plain>(site).raw_ptr();
+
+  ASSERT_EQ(report_of(site).alive_acquired, 1u);
+}
+
+TEST_F(owned_pointer_site_report_ut, objectGivenBackAndAcquiredAgainIsCountedOnce)
+{
+  auto& site = OWNED_POINTER_SITE;
+  auto p = csp::make_owned_at<polymorphic>(site);
+
+  csp::owned_pointer<polymorphic> back{p.unique_ptr()};
+  p = nullptr;
+  auto u = back.unique_ptr();
+
+  auto report = report_of(site);
+  ASSERT_EQ(report.created, 1u);
+  ASSERT_EQ(report.alive_unacquired, 0u);
+  ASSERT_EQ(report.alive_acquired, 1u);
+
+  back = csp::owned_pointer<polymorphic>{std::move(u)};
+  back = nullptr;
+
+  report = report_of(site);
+  ASSERT_EQ(report.never_acquired, 0u);
+  ASSERT_EQ(report.alive_unacquired, 0u);
+  ASSERT_EQ(report.alive_acquired, 0u);
+}
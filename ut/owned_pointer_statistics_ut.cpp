@@ -0,0 +1,136 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#define OWNED_POINTER_STATISTICS
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "owned_pointer.hpp"
+
+class owned_pointer_statistics_ut : public ::testing::Test
+{
+protected:
+  struct counted_base
+  {
+    virtual ~counted_base() = default;
+    long payload[3];
+  };
+
+  struct plain
+  {
+    int value;
+  };
+
+  void expect_difference(const csp::lifecycle_counters& before, const csp::lifecycle_counters& after,
+                         const std::size_t created, const std::size_t acquired, const std::size_t expired,
+                         const std::size_t never_acquired, const std::size_t live_objects)
+  {
+    EXPECT_EQ(after.created - before.created, created);
+    EXPECT_EQ(after.acquired - before.acquired, acquired);
+    EXPECT_EQ(after.expired - before.expired, expired);
+    EXPECT_EQ(after.never_acquired - before.never_acquired, never_acquired);
+    EXPECT_EQ(after.live_objects - before.live_objects, live_objects);
+  }
+};
+
+TEST_F(owned_pointer_statistics_ut, countsLifecycleOfPolymorphicObjects)
+{
+  const auto before = csp::lifecycle_snapshot<counted_base>();
+
+  auto p = csp::make_owned<counted_base>();
+  auto r = csp::make_owned<counted_base>();
+  auto u = r.unique_ptr();
+  expect_difference(before, csp::lifecycle_snapshot<counted_base>(), 2, 1, 0, 0, 2);
+
+  u.reset();
+  p = nullptr;
+
+  const auto after = csp::lifecycle_snapshot<counted_base>();
+  expect_difference(before, after, 2, 1, 1, 1, 0);
+  ASSERT_EQ(after.live_bytes, after.live_objects * sizeof(counted_base));
+}
+
+TEST_F(owned_pointer_statistics_ut, countersOfExitedThreadsAreKept)
+{
+  const auto before = csp::lifecycle_snapshot<plain>();
+  csp::owned_pointer<plain> p;
+
+  std::thread{[&p] { p = csp::make_owned<plain>(); }}.join();
+  std::thread{[&p] { delete p.raw_ptr(); }}.join();
+
+  const auto after = csp::lifecycle_snapshot<plain>();
+  expect_difference(before, after, 1, 1, 0, 0, 1);
+  ASSERT_EQ(after.live_bytes, sizeof(plain));
+}
+
+TEST_F(owned_pointer_statistics_ut, snapshotSumsAllTypes)
+{
+  const auto before = csp::lifecycle_snapshot();
+
+  auto range = csp::make_owned_n<counted_base>(3);
+  auto p = csp::make_owned<plain>();
+  auto all = range.acquire_all();
+
+  expect_difference(before, csp::lifecycle_snapshot(), 4, 3, 0, 0, 4);
+}
+
+TEST_F(owned_pointer_statistics_ut, pointerMovedFromUniquePtrIsCounted)
+{
+  const auto before = csp::lifecycle_snapshot<plain>();
+
+  csp::owned_pointer<plain> p{std::unique_ptr<plain>(new plain{})};
+  auto copy = p;
+  expect_difference(before, csp::lifecycle_snapshot<plain>(), 1, 0, 0, 0, 1);
+
+  p = copy = nullptr;
+  expect_difference(before, csp::lifecycle_snapshot<plain>(), 1, 0, 0, 1, 0);
+}
+
+TEST_F(owned_pointer_statistics_ut, objectGivenBackIsAcquiredOnce)
+{
+  const auto before = csp::lifecycle_snapshot<counted_base>();
+
+  auto p = csp::make_owned<counted_base>();
+  csp::owned_pointer<counted_base> back{p.unique_ptr()};
+  p = nullptr;
+  auto u = back.unique_ptr();
+  expect_difference(before, csp::lifecycle_snapshot<counted_base>(), 1, 1, 0, 0, 1);
+
+  u.reset();
+  expect_difference(before, csp::lifecycle_snapshot<counted_base>(), 1, 1, 1, 0, 0);
+}
+
+TEST_F(owned_pointer_statistics_ut, objectGivenBackAndFreedByOwnerExpires)
+{
+  const auto before = csp::lifecycle_snapshot<counted_base>();
+
+  auto p = csp::make_owned<counted_base>();
+  csp::owned_pointer<counted_base> back{p.unique_ptr()};
+  p = nullptr;
+  expect_difference(before, csp::lifecycle_snapshot<counted_base>(), 1, 1, 0, 0, 1);
+
+  back = nullptr;
+  expect_difference(before, csp::lifecycle_snapshot<counted_base>(), 1, 1, 1, 0, 0);
+}
@@ -0,0 +1,110 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2017 Przemyslaw Wos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+**/
+#define OWNED_POINTER_TRACING
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "owned_pointer.hpp"
+
+class owned_pointer_tracing_ut : public ::testing::Test
+{
+protected:
+  struct polymorphic
+  {
+    virtual ~polymorphic() = default;
+  };
+
+  auto trace() -> std::string
+  {
+    const auto file = std::tmpfile();
+    csp::write_chrome_trace(file);
+
+    std::string text(static_cast<std::size_t>(std::ftell(file)), '\0');
+    std::rewind(file);
+    text.resize(std::fread(&text[0], 1, text.size(), file));
+
+    return std::fclose(file), text;
+  }
+
+  auto count(const std::string& text, const std::string& what) -> std::size_t
+  {
+    std::size_t n = 0;
+    for(auto i = text.find(what); i != std::string::npos; i = text.find(what, i + 1))
+      n++;
+
+    return n;
+  }
+
+  auto block_id(const csp::owned_pointer<polymorphic>& p) -> std::string
+  {
+    char id[32];
+    std::snprintf(id, sizeof(id), "\"id\":\"0x%llx\"",
+                  static_cast<unsigned long long>(reinterpret_cast<std::uintptr_t>(csp::_priv::access::control_block_of(p))));
+    return id;
+  }
+};
+
+TEST_F(owned_pointer_tracing_ut, lifetimeOfObjectIsAsyncSlice)
+{
+  auto p = csp::make_owned<polymorphic>();
+  const auto id = block_id(p);
+
+  std::thread{[p] { auto copy = p; copy.unique_ptr(); }}.join();
+
+  const auto text = trace();
+  ASSERT_EQ(text.front(), '{');
+  ASSERT_EQ(text.substr(text.size() - 3), "]}\n");
+
+  const auto events = count(text, id);
+  ASSERT_GE(events, 5u);
+  ASSERT_EQ(count(text, "\"ph\":\"b\",\"id\":\"" + id.substr(6)), 1u);
+  ASSERT_EQ(count(text, "\"ph\":\"e\",\"id\":\"" + id.substr(6)), 1u);
+}
+
+TEST_F(owned_pointer_tracing_ut, objectFreedWithoutAcquisitionEndsSlice)
+{
+  auto p = csp::make_owned<polymorphic>();
+  const auto id = block_id(p);
+  p = nullptr;
+
+  const auto text = trace();
+  ASSERT_NE(text.find(id + ",\"ts\""), std::string::npos);
+  ASSERT_NE(text.find("never acquired"), std::string::npos);
+}
+
+TEST_F(owned_pointer_tracing_ut, pointerMovedFromUniquePtrBeginsSlice)
+{
+  csp::owned_pointer<polymorphic> p{std::unique_ptr<polymorphic>(new polymorphic{})};
+  const auto id = block_id(p);
+  p = nullptr;
+
+  const auto text = trace();
+  const auto begins = count(text, "\"ph\":\"b\",\"id\":\"" + id.substr(6));
+  ASSERT_GE(begins, 1u);
+  ASSERT_EQ(count(text, "\"ph\":\"e\",\"id\":\"" + id.substr(6)), begins);
+}
@@ -21,11 +21,13 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
 **/
-#include <gmock/gmock-generated-matchers.h>
 #include <gmock/gmock-matchers.h>
 #include <gtest/gtest.h>
+#include <gtest/gtest-spi.h>
 #include <gmock/gmock.h>
 
+#include <thread>
+
 #include "owned_pointer.hpp"
 #include "gmock_macros_for_unique_ptr.hpp"
 
@@ -59,6 +61,50 @@ protected:
     MOCK_UNIQUE_CONST_METHOD1(test, int(const std::unique_ptr<simple_base_class>));
   };
 
+  struct valued_class : public simple_base_class
+  {
+    valued_class(int v, std::string n) : value(v), name(std::move(n)) {}
+
+    int value;
+    std::string name;
+  };
+
+  struct factory
+  {
+    virtual std::unique_ptr<simple_base_class> create() const = 0;
+    virtual ~factory() = default;
+  };
+
+  struct factory_mock : public factory
+  {
+    MOCK_UNIQUE_CONST_METHOD0(create, std::unique_ptr<simple_base_class>());
+  };
+
+  struct wide_interface
+  {
+    virtual std::unique_ptr<simple_base_class> build(int, std::unique_ptr<simple_base_class>,
+                                                     std::pair<int, int>) const = 0;
+    virtual int spread(int, int, int, int, int, int, int, int, int, int, int,
+                       std::unique_ptr<simple_base_class>) = 0;
+    virtual ~wide_interface() = default;
+  };
+
+  struct wide_mock : public wide_interface
+  {
+    MOCK_UNIQUE_METHOD(std::unique_ptr<simple_base_class>, build,
+                       (int, std::unique_ptr<simple_base_class>, (std::pair<int, int>)), (const, override));
+    MOCK_UNIQUE_METHOD(int, spread, (int, int, int, int, int, int, int, int, int, int, int,
+                                     std::unique_ptr<simple_base_class>), (override));
+  };
+
+  struct wide_stub : public wide_interface
+  {
+    STUB_UNIQUE_METHOD(std::unique_ptr<simple_base_class>, build,
+                       (int, std::unique_ptr<simple_base_class>, (std::pair<int, int>)), (const, override));
+    STUB_UNIQUE_METHOD(int, spread, (int, int, int, int, int, int, int, int, int, int, int,
+                                     std::unique_ptr<simple_base_class>), (override));
+  };
+
   typedef StrictMock<destruction_test_mock> test_mock;
 
   template<typename T> void assert_that_operators_throw(csp::owned_pointer<T> &p)
@@ -145,6 +191,37 @@ protected:
     MOCK_UNIQUE_METHOD1(create, std::unique_ptr<std::ostream>(const std::string&));
   };
 
+  template<typename T>
+  struct counting_allocator
+  {
+    using value_type = T;
+
+    explicit counting_allocator(int& c) : allocations(&c) {}
+
+    template<typename U>
+    counting_allocator(const counting_allocator<U>& other) : allocations(other.allocations) {}
+
+    T* allocate(std::size_t n) { return ++*allocations, std::allocator<T>{}.allocate(n); }
+    void deallocate(T* p, std::size_t n) { --*allocations; std::allocator<T>{}.deallocate(p, n); }
+
+    template<typename U>
+    bool operator==(const counting_allocator<U>& other) const { return allocations == other.allocations; }
+
+    template<typename U>
+    bool operator!=(const counting_allocator<U>& other) const { return allocations != other.allocations; }
+
+    int* allocations;
+  };
+
+  struct non_virtual_class
+  {
+    non_virtual_class(int& d, int v) : destroyed(&d), value(v) {}
+    ~non_virtual_class() { ++*destroyed; }
+
+    int* destroyed;
+    int value;
+  };
+
   struct Taker
   {
     virtual void giveme(std::ostream&) = 0;
@@ -439,6 +516,149 @@ TEST_F(owned_pointer_ut, testConversionInGoogleMockParams)
   assert_that_operators_dont_throw(p);
 }
 
+TEST_F(owned_pointer_ut, uniqueMethodMacroMocksAnyNumberOfArguments)
+{
+  wide_mock m;
+  wide_interface& base = m;
+  auto p = csp::make_owned<test_mock>();
+  auto q = csp::make_owned<test_mock>();
+
+  expect_object_will_be_deleted(p);
+  expect_object_will_be_deleted(q);
+  EXPECT_CALL(m, _build(1, Eq(p), std::make_pair(2, 3))).WillOnce(Return(q));
+  EXPECT_CALL(m, _spread(_, _, _, _, _, _, _, _, _, _, 11, Eq(q))).WillOnce(Return(12));
+
+  auto u = base.build(1, p.unique_ptr(), std::make_pair(2, 3));
+  ASSERT_EQ(u.get(), q.get());
+  ASSERT_EQ(12, base.spread(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, std::move(u)));
+  assert_that_operators_dont_throw(q);
+}
+
+TEST_F(owned_pointer_ut, returnOwnedFromHandsOutBatchInOrder)
+{
+  factory_mock f;
+  const factory& base = f;
+  auto batch = csp::make_owned_n<simple_base_class>(3);
+  const auto action = pobu_gmock::ReturnOwnedFrom(batch);
+  EXPECT_CALL(f, _create()).Times(3).WillRepeatedly(action);
+
+  auto first = base.create();
+  auto second = base.create();
+  ASSERT_EQ(action.size(), 2u);
+  ASSERT_EQ(first.get(), batch[0].get());
+  ASSERT_EQ(second.get(), batch[1].get());
+  ASSERT_TRUE(action[1].acquired());
+
+  second.reset();
+  ASSERT_TRUE(action[1].expired());
+  ASSERT_TRUE(batch[1].expired());
+  ASSERT_FALSE(action[0].expired());
+  ASSERT_EQ(base.create().get(), batch[2].get());
+}
+
+TEST_F(owned_pointer_ut, returnOwnedFromFailsWhenBatchIsExhausted)
+{
+  factory_mock f;
+  const factory& base = f;
+  EXPECT_CALL(f, _create()).WillRepeatedly(pobu_gmock::ReturnOwnedFrom(csp::make_owned_n<simple_base_class>(1)));
+
+  ASSERT_NE(base.create(), nullptr);
+  std::unique_ptr<simple_base_class> u;
+  EXPECT_NONFATAL_FAILURE(u = base.create(), "all 1 objects were already returned");
+  ASSERT_EQ(u, nullptr);
+}
+
+TEST_F(owned_pointer_ut, returnNewOwnedConstructsObjectOnEveryCall)
+{
+  factory_mock f;
+  const factory& base = f;
+  const auto action = pobu_gmock::ReturnNewOwned<valued_class>(7, "seven").record(2);
+  EXPECT_CALL(f, _create()).Times(2).WillRepeatedly(action);
+
+  auto first = base.create();
+  const auto second = base.create();
+  ASSERT_NE(first.get(), second.get());
+  ASSERT_EQ(static_cast<valued_class&>(*second).value, 7);
+  ASSERT_EQ(static_cast<valued_class&>(*second).name, "seven");
+
+  first.reset();
+  ASSERT_EQ(action.size(), 2u);
+  ASSERT_TRUE(action[0].expired());
+  ASSERT_TRUE(action[1].acquired());
+  ASSERT_FALSE(action[1].expired());
+}
+
+TEST_F(owned_pointer_ut, objectsHandedOutByFactoryExpireWhenConsumerFreesThem)
+{
+  factory_mock f;
+  mock_class consumer;
+  const factory& source = f;
+  const mock_interface& sink = consumer;
+  const auto batch = pobu_gmock::ReturnOwnedFrom(csp::make_owned_n<simple_base_class>(1));
+  const auto created = pobu_gmock::ReturnNewOwned<valued_class>(1, "one").record(1);
+  EXPECT_CALL(f, _create()).WillOnce(batch).WillOnce(created);
+  EXPECT_CALL(consumer, _test(_)).Times(2).WillRepeatedly(Return(0));
+
+  sink.test(source.create());
+  sink.test(source.create());
+
+  EXPECT_TRUE(batch[0].expired());
+  EXPECT_TRUE(created[0].expired());
+}
+
+TEST_F(owned_pointer_ut, returnNewOwnedRecordsOnlyRequestedObjects)
+{
+  factory_mock f;
+  const factory& base = f;
+  const auto counted = pobu_gmock::ReturnNewOwned<valued_class>(1, "one");
+  const auto recorded = pobu_gmock::ReturnNewOwned<valued_class>(2, "two").record(1);
+  EXPECT_CALL(f, _create()).WillOnce(counted).WillOnce(counted).WillRepeatedly(recorded);
+
+  base.create();
+  base.create();
+  auto first = base.create();
+  base.create();
+
+  ASSERT_EQ(counted.size(), 2u);
+  ASSERT_EQ(recorded.size(), 2u);
+  ASSERT_TRUE(recorded[0].acquired());
+  ASSERT_FALSE(recorded[0].expired());
+
+  first.reset();
+  ASSERT_TRUE(recorded[0].expired());
+}
+
+TEST_F(owned_pointer_ut, stubUniqueMethodReturnsDefaultValueUntilSet)
+{
+  wide_stub s;
+  wide_interface& base = s;
+  std::unique_ptr<destruction_test_mock> u(new test_mock());
+  EXPECT_CALL(*u, die());
+
+  ASSERT_EQ(base.build(1, nullptr, {2, 3}), nullptr);
+  ASSERT_EQ(base.spread(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, std::move(u)), 0);
+}
+
+TEST_F(owned_pointer_ut, stubUniqueMethodDispatchesToCallable)
+{
+  wide_stub s;
+  const wide_interface& base = s;
+  csp::owned_pointer<simple_base_class> seen;
+  s._build = [&seen](int v, csp::owned_pointer<simple_base_class> p, std::pair<int, int> n)
+  {
+    seen = p;
+    return csp::make_owned<valued_class>(v + n.first + n.second, "built");
+  };
+
+  std::unique_ptr<simple_base_class> arg(new simple_base_class());
+  const auto raw = arg.get();
+  auto u = base.build(1, std::move(arg), {2, 3});
+
+  ASSERT_EQ(static_cast<valued_class&>(*u).value, 6);
+  ASSERT_EQ(seen.get(), raw);
+  ASSERT_FALSE(seen.acquired());
+}
+
 TEST_F(owned_pointer_ut, testIsNullAndNotNullMatchers)
 {
   mock_class m;
@@ -584,3 +804,490 @@ TEST_F(owned_pointer_ut, testCBeginEndAndSizePropagation)
   ASSERT_THAT(o.size(), ::testing::Eq(5));
   ASSERT_THAT(v, ::testing::ElementsAre(1,2,3,4,5));
 }
+
+TEST_F(owned_pointer_ut, exceptionFromConstructorIsPropagatedByMakeOwned)
+{
+  struct throwing_base_class : simple_base_class
+  {
+    throwing_base_class() { throw std::logic_error("ctor"); }
+  };
+
+  ASSERT_THROW(csp::make_owned<throwing_base_class>(), std::logic_error);
+}
+
+TEST_F(owned_pointer_ut, sharedStateOutlivesObjectDeletedByUniquePtr)
+{
+  auto p = csp::make_owned<test_mock>();
+  auto copy = p;
+
+  expect_object_will_be_deleted(p);
+  p.unique_ptr().reset();
+
+  p = nullptr;
+  assert_that_operators_throw(copy);
+}
+
+TEST_F(owned_pointer_ut, allocateOwnedReturnsMemoryToAllocatorWhenNotAcquired)
+{
+  int allocations = 0;
+  {
+    auto p = csp::allocate_owned<test_mock>(counting_allocator<test_mock>{allocations}, 7);
+    expect_object_will_be_deleted(p);
+
+    ASSERT_EQ(p->x, 7);
+    ASSERT_EQ(allocations, 1);
+  }
+  ASSERT_EQ(allocations, 0);
+}
+
+TEST_F(owned_pointer_ut, allocateOwnedReturnsMemoryToAllocatorWhenUniquePtrDeletes)
+{
+  int allocations = 0;
+  std::unique_ptr<test_mock> u;
+  {
+    auto p = csp::allocate_owned<test_mock>(counting_allocator<test_mock>{allocations});
+    expect_object_will_be_deleted(p);
+    u = p.unique_ptr();
+  }
+
+  ASSERT_EQ(allocations, 1);
+  u.reset();
+  ASSERT_EQ(allocations, 0);
+}
+
+TEST_F(owned_pointer_ut, allocateOwnedReturnsMemoryOfNonVirtualTypeWhenNotAcquired)
+{
+  int allocations = 0;
+  int destroyed = 0;
+  {
+    auto p = csp::allocate_owned<non_virtual_class>(counting_allocator<non_virtual_class>{allocations}, destroyed, 7);
+
+    ASSERT_EQ(p->value, 7);
+    ASSERT_EQ(allocations, 1);
+  }
+  ASSERT_EQ(destroyed, 1);
+  ASSERT_EQ(allocations, 0);
+}
+
+TEST_F(owned_pointer_ut, allocateOwnedObjectOfNonVirtualTypeIsFreedOnlyByTrackedUniquePtr)
+{
+  int allocations = 0;
+  int destroyed = 0;
+  auto p = csp::allocate_owned<non_virtual_class>(counting_allocator<non_virtual_class>{allocations}, destroyed, 7);
+  auto copy = p;
+
+  ASSERT_THROW(p.unique_ptr(), csp::unique_ptr_can_not_free_object);
+  ASSERT_THROW(p.raw_ptr(), csp::unique_ptr_can_not_free_object);
+  ASSERT_FALSE(p.acquired());
+
+  auto u = p.tracked_unique_ptr();
+  p = nullptr;
+  u.reset();
+
+  ASSERT_EQ(destroyed, 1);
+  ASSERT_TRUE(copy.expired());
+  ASSERT_EQ(allocations, 1);
+
+  copy = nullptr;
+  ASSERT_EQ(allocations, 0);
+}
+
+TEST_F(owned_pointer_ut, handleIsSinglePointer)
+{
+  static_assert(sizeof(csp::owned_pointer<int>) == sizeof(void*), "handle is not single pointer");
+  static_assert(sizeof(csp::owned_pointer<test_mock>) == sizeof(void*), "handle is not single pointer");
+
+  auto p = csp::make_owned<test_mock>();
+  csp::owned_pointer<simple_base_class> r = p;
+  expect_object_will_be_deleted(p);
+
+  ASSERT_EQ(p.use_count(), 2);
+  r = nullptr;
+  ASSERT_EQ(p.use_count(), 1);
+}
+
+TEST_F(owned_pointer_ut, onlyOneThreadAcquiresUniquePtr)
+{
+  auto p = csp::make_owned<test_mock>();
+  expect_object_will_be_deleted(p);
+
+  std::atomic<int> winners{0};
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<test_mock>> acquired(8);
+
+  for(std::size_t i = 0; i < acquired.size(); i++)
+    threads.emplace_back([&acquired, &winners, i, p]()
+    {
+      try
+      {
+        acquired[i] = p.unique_ptr();
+        ++winners;
+      }
+      catch(const csp::unique_ptr_already_acquired&)
+      {}
+    });
+
+  for(auto& t : threads)
+    t.join();
+
+  ASSERT_EQ(winners, 1);
+  ASSERT_TRUE(p.acquired());
+}
+
+TEST_F(owned_pointer_ut, singleThreadedPolicyKeepsSemantics)
+{
+  using local_pointer = csp::owned_pointer<destruction_test_mock, csp::single_threaded>;
+
+  local_pointer p = csp::make_owned<test_mock>();
+  expect_object_will_be_deleted(p);
+
+  local_pointer r = p;
+  csp::owned_pointer<simple_base_class, csp::single_threaded> b = r;
+
+  ASSERT_EQ(p.use_count(), 3);
+  ASSERT_TRUE(p == r && r == b);
+
+  auto u = r.unique_ptr();
+  ASSERT_TRUE(p.acquired());
+  ASSERT_THROW(b.unique_ptr(), csp::unique_ptr_already_acquired);
+
+  u.reset();
+  ASSERT_TRUE(p.expired());
+  ASSERT_THROW(*r, csp::ptr_is_already_deleted);
+}
+
+TEST_F(owned_pointer_ut, dynamicPointerCastSharesOwnershipState)
+{
+  csp::owned_pointer<simple_base_class> p = csp::make_owned<test_mock>();
+  auto u = p.unique_ptr();
+
+  auto d = csp::dynamic_pointer_cast<destruction_test_mock>(p);
+  expect_object_will_be_deleted(d);
+
+  ASSERT_EQ(d, p);
+  ASSERT_TRUE(d.acquired());
+  ASSERT_TRUE(is_expired_enabled_f(d));
+  ASSERT_EQ(p.use_count(), 2);
+
+  u.reset();
+  assert_that_operators_throw(d);
+}
+
+TEST_F(owned_pointer_ut, makeOwnedNCreatesIndependentObjects)
+{
+  auto range = csp::make_owned_n<test_mock>(3, 5);
+  ASSERT_EQ(range.size(), 3u);
+
+  for(auto& p : range)
+  {
+    expect_object_will_be_deleted(p);
+    ASSERT_EQ(p->x, 5);
+    ASSERT_TRUE(is_expired_enabled_f(p));
+  }
+
+  auto u = range[1].unique_ptr();
+  ASSERT_FALSE(range[0].acquired());
+  ASSERT_TRUE(range[1].acquired());
+
+  u.reset();
+  ASSERT_TRUE(range[1].expired());
+  ASSERT_FALSE(range[2].expired());
+}
+
+TEST_F(owned_pointer_ut, acquireAllTakesEveryObjectOrNone)
+{
+  auto range = csp::make_owned_n<test_mock>(3);
+  for(auto& p : range)
+    expect_object_will_be_deleted(p);
+
+  auto u = range[2].unique_ptr();
+  ASSERT_THROW(range.acquire_all(), csp::unique_ptr_already_acquired);
+  ASSERT_FALSE(range[0].acquired());
+  ASSERT_FALSE(range[1].acquired());
+
+  u.reset();
+  ASSERT_THROW(range.acquire_all(), csp::ptr_is_already_deleted);
+
+  range.erase(range.begin() + 2, range.end());
+  auto all = range.acquire_all();
+  ASSERT_EQ(all.size(), 2u);
+  ASSERT_EQ(all[0].get(), range[0].get());
+
+  all.clear();
+  ASSERT_TRUE(range[0].expired() && range[1].expired());
+}
+
+TEST_F(owned_pointer_ut, makeOwnedNWorksForNonVirtualTypes)
+{
+  auto range = csp::make_owned_n<int>(4, 7);
+  auto copy = range[3];
+
+  range = decltype(range){};
+  ASSERT_EQ(*copy, 7);
+  ASSERT_EQ(*copy.unique_ptr(), 7);
+  ASSERT_EQ(csp::make_owned_n<int>(0).size(), 0u);
+}
+
+TEST_F(owned_pointer_ut, rangeAlgorithmsSweepExpiredPointers)
+{
+  std::vector<csp::owned_pointer<destruction_test_mock>> v;
+  for(int i = 0; i < 20; i++)
+    v.push_back(i % 5 ? csp::make_owned<test_mock>(i) : nullptr);
+
+  for(auto& p : v)
+    if(p)
+      expect_object_will_be_deleted(p);
+
+  std::vector<std::unique_ptr<destruction_test_mock>> u;
+  csp::acquire_all(v, std::back_inserter(u));
+  ASSERT_EQ(u.size(), v.size());
+  ASSERT_EQ(csp::count_expired(v), 0u);
+
+  for(std::size_t i = 0; i < u.size(); i += 2)
+    u[i].reset();
+
+  ASSERT_EQ(csp::count_expired(v), 8u);
+  ASSERT_EQ(csp::erase_expired(v), 8u);
+  ASSERT_EQ(v.size(), 12u);
+  ASSERT_EQ(v[0], nullptr);
+  ASSERT_EQ(v[1]->x, 1);
+  ASSERT_EQ(v[2]->x, 3);
+}
+
+TEST_F(owned_pointer_ut, acquireAllRollsBackWhenAnyPointerIsAcquired)
+{
+  std::vector<csp::owned_pointer<destruction_test_mock>> v;
+  for(int i = 0; i < 12; i++)
+    v.push_back(csp::make_owned<test_mock>(i));
+
+  for(auto& p : v)
+    expect_object_will_be_deleted(p);
+
+  auto last = v.back().unique_ptr();
+  std::vector<std::unique_ptr<destruction_test_mock>> u;
+
+  ASSERT_THROW(csp::acquire_all(v, std::back_inserter(u)), csp::unique_ptr_already_acquired);
+  ASSERT_TRUE(u.empty());
+  ASSERT_FALSE(v.front().acquired());
+}
+
+TEST_F(owned_pointer_ut, uncheckedAccessPolicySkipsExpiryCheck)
+{
+  csp::owned_pointer<destruction_test_mock, csp::unchecked<>> p = csp::make_owned<test_mock>();
+  csp::owned_pointer<destruction_test_mock, csp::debug_checked<csp::single_threaded>> d = p;
+  expect_object_will_be_deleted(p);
+
+  const auto address = p.get();
+  p.unique_ptr().reset();
+
+  ASSERT_TRUE(p.expired());
+  ASSERT_EQ(p.get(), address);
+  ASSERT_EQ(p.get(std::nothrow), nullptr);
+  ASSERT_THROW(p.unique_ptr(), csp::ptr_is_already_deleted);
+
+#ifdef NDEBUG
+  ASSERT_EQ(d.get(), address);
+#else
+  ASSERT_THROW(d.get(), csp::ptr_is_already_deleted);
+#endif
+}
+
+TEST_F(owned_pointer_ut, observerSeesExpiryWithoutOwningObject)
+{
+  csp::owned_observer<destruction_test_mock> observer;
+  ASSERT_FALSE(observer);
+  ASSERT_FALSE(observer.expired());
+  ASSERT_FALSE(observer.lock());
+
+  {
+    csp::owned_pointer<destruction_test_mock> p = csp::make_owned<test_mock>();
+    observer = p;
+    const auto copy = observer;
+
+    ASSERT_EQ(p.use_count(), 1);
+    ASSERT_EQ(copy.lock().get(), p.get());
+    ASSERT_EQ(p.use_count(), 1);
+    ASSERT_FALSE(copy.expired());
+
+    expect_object_will_be_deleted(p);
+  }
+
+  ASSERT_TRUE(observer);
+  ASSERT_TRUE(observer.expired());
+  ASSERT_FALSE(observer.lock());
+  ASSERT_EQ(observer.use_count(), 0);
+}
+
+TEST_F(owned_pointer_ut, observerOutlivesAcquiredObject)
+{
+  csp::owned_pointer<destruction_test_mock> p = csp::make_owned<test_mock>();
+  const csp::owned_observer<simple_base_class> observer = p;
+  expect_object_will_be_deleted(p);
+
+  auto object = p.unique_ptr();
+  p = nullptr;
+
+  ASSERT_TRUE(observer.acquired());
+  ASSERT_FALSE(observer.expired());
+  ASSERT_FALSE(observer.lock());
+
+  object.reset();
+  ASSERT_TRUE(observer.expired());
+}
+
+TEST_F(owned_pointer_ut, observerFollowsObjectGivenBackAfterLastOwnerIsGone)
+{
+  csp::owned_pointer<destruction_test_mock> p = csp::make_owned<test_mock>();
+  const csp::owned_observer<destruction_test_mock> observer = p;
+  expect_object_will_be_deleted(p);
+
+  auto object = p.unique_ptr();
+  p = nullptr;
+
+  csp::owned_pointer<destruction_test_mock> back{std::move(object)};
+  ASSERT_EQ(observer.lock().get(), back.get());
+  ASSERT_FALSE(observer.acquired());
+
+  back.unique_ptr().reset();
+  ASSERT_TRUE(back.expired());
+  ASSERT_TRUE(observer.expired());
+}
+
+TEST_F(owned_pointer_ut, observerFollowsTrackedObjectGivenBackAfterLastOwnerIsGone)
+{
+  auto p = csp::make_owned<int>(5);
+  const csp::owned_observer<int> observer = p;
+
+  auto object = p.tracked_unique_ptr();
+  p = nullptr;
+
+  csp::owned_pointer<int> back{std::move(object)};
+  ASSERT_EQ(observer.lock().get(), back.get());
+
+  back.tracked_unique_ptr().reset();
+  ASSERT_TRUE(back.expired());
+  ASSERT_TRUE(observer.expired());
+}
+
+TEST_F(owned_pointer_ut, trackedUniquePtrFlagsDeletionOfNonVirtualType)
+{
+  const auto p = csp::make_owned<int>(5);
+  auto u = p.tracked_unique_ptr();
+
+  ASSERT_EQ(sizeof(u), 2 * sizeof(void*));
+  ASSERT_EQ(*u, 5);
+  ASSERT_TRUE(p.acquired());
+  ASSERT_FALSE(p.expired());
+  ASSERT_THROW(p.tracked_unique_ptr(), csp::unique_ptr_already_acquired);
+
+  u.reset();
+
+  ASSERT_TRUE(p.expired());
+  ASSERT_EQ(p.get(std::nothrow), nullptr);
+  ASSERT_THROW(p.get(), csp::ptr_is_already_deleted);
+  ASSERT_THROW(p.operator->(), csp::ptr_is_already_deleted);
+  ASSERT_THROW(*p, csp::ptr_is_already_deleted);
+  ASSERT_THROW(p.unique_ptr(), csp::ptr_is_already_deleted);
+}
+
+TEST_F(owned_pointer_ut, trackedUniquePtrOutlivesItsOwnedPointers)
+{
+  csp::tracked_unique_ptr<destruction_test_mock> u;
+  {
+    const csp::owned_pointer<destruction_test_mock> p = csp::make_owned<test_mock>();
+    expect_object_will_be_deleted(p);
+    u = p.tracked_unique_ptr();
+  }
+
+  const csp::tracked_unique_ptr<simple_base_class> base = std::move(u);
+  ASSERT_NE(base, nullptr);
+}
+
+TEST_F(owned_pointer_ut, trackedUniquePtrReturnsObjectToItsOwners)
+{
+  const auto p = csp::make_owned<int>(3);
+  csp::owned_pointer<int> r = p.tracked_unique_ptr();
+
+  ASSERT_EQ(r, p);
+  ASSERT_EQ(p.use_count(), 2);
+  ASSERT_FALSE(p.acquired());
+
+  auto u = r.tracked_unique_ptr();
+  r = nullptr;
+  csp::owned_pointer<int> q{std::move(u)};
+  ASSERT_EQ(q, p);
+}
+
+TEST_F(owned_pointer_ut, pointerMovedFromUniquePtrCreatesStateOnFirstCopy)
+{
+  csp::owned_pointer<int> p{std::unique_ptr<int>{new int{3}}};
+  ASSERT_EQ(p.use_count(), 1);
+  ASSERT_FALSE(p.acquired());
+
+  const auto copy = p;
+  ASSERT_EQ(p.use_count(), 2);
+  ASSERT_EQ(copy.get(), p.get());
+
+  auto u = copy.unique_ptr();
+  ASSERT_TRUE(p.acquired());
+  ASSERT_THROW(p.unique_ptr(), csp::unique_ptr_already_acquired);
+  ASSERT_EQ(*u, 3);
+}
+
+TEST_F(owned_pointer_ut, pointerMovedFromUniquePtrIsAcquiredOnlyOnce)
+{
+  auto raw = new int{4};
+  const csp::owned_pointer<int> p{std::unique_ptr<int>{raw}};
+
+  auto u = p.unique_ptr();
+  ASSERT_EQ(u.get(), raw);
+  ASSERT_TRUE(p.acquired());
+  ASSERT_THROW(p.unique_ptr(), csp::unique_ptr_already_acquired);
+
+  const auto copy = p;
+  ASSERT_TRUE(copy.acquired());
+  ASSERT_EQ(copy.get(), raw);
+  ASSERT_THROW(copy.unique_ptr(), csp::unique_ptr_already_acquired);
+
+  csp::owned_pointer<int> back{std::move(u)};
+  ASSERT_EQ(back.get(), raw);
+  ASSERT_EQ(back.use_count(), 1);
+}
+
+TEST_F(owned_pointer_ut, linkedPointerCreatesStateOnFirstCopy)
+{
+  auto u = std::unique_ptr<int>{new int{5}};
+  const csp::owned_pointer<int> p{csp::link(u)};
+
+  ASSERT_TRUE(p.acquired());
+  ASSERT_THROW(p.unique_ptr(), csp::unique_ptr_already_acquired);
+
+  const csp::owned_observer<int> observer = p;
+  ASSERT_EQ(observer.lock(), p);
+  ASSERT_TRUE(observer.acquired());
+}
+
+TEST_F(owned_pointer_ut, concurrentCopiesOfPointerMovedFromUniquePtrShareOneState)
+{
+  constexpr int threads = 4;
+  constexpr int copies = 100;
+
+  const csp::owned_pointer<int> p{std::unique_ptr<int>{new int{6}}};
+  std::vector<std::vector<csp::owned_pointer<int>>> made(threads);
+  std::vector<std::thread> workers;
+
+  for(int t = 0; t < threads; t++)
+    workers.emplace_back([&p, &made, t]
+    {
+      for(int i = 0; i < copies; i++)
+        made[t].push_back(p);
+    });
+
+  for(auto& w : workers)
+    w.join();
+
+  ASSERT_EQ(p.use_count(), threads * copies + 1);
+  for(const auto& m : made)
+    for(const auto& copy : m)
+      ASSERT_EQ(copy, p);
+}